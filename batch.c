@@ -0,0 +1,175 @@
+#define _DEFAULT_SOURCE
+#include "batch.h"
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "dataset.h"
+#include "parse_args.h"
+
+// Listings of one batch run; failed has one flag per listing, written by the thread evaluating it.
+typedef struct {
+    const Batch *batch;
+    const char *output;
+    bool *failed;
+} BatchRun;
+
+static const char *const output_extensions[] = {
+    [FORMAT_TEXT] = "txt",
+    [FORMAT_NDJSON] = "ndjson",
+    [FORMAT_COLUMNAR] = "cols",
+};
+
+// Adds the line to the batch unless it is empty or a comment.
+static bool add_batch_line(Batch *batch, const Filters *filters, char *line, size_t line_number) {
+    char *end = line + strlen(line);
+    while (end > line && isspace((unsigned char) end[-1])) {
+        *--end = '\0';
+    }
+    while (isspace((unsigned char) *line)) {
+        line++;
+    }
+    if (*line == '\0' || *line == '#') {
+        return true;
+    }
+
+    BatchQuery *grown = realloc(batch->queries, (batch->count + 1) * sizeof(BatchQuery));
+    if (grown == NULL) {
+        return false;
+    }
+    batch->queries = grown;
+    BatchQuery *query = &batch->queries[batch->count];
+    if ((query->text = strdup(line)) == NULL) {
+        return false;
+    }
+    query->filters = parse_batch_line(filters, line, line_number);
+    query->filters.threads = 1;
+    batch->count++;
+    return true;
+}
+
+bool load_batch(Batch *batch, const Filters *filters) {
+    batch->queries = NULL;
+    batch->count = 0;
+
+    bool from_stdin = strcmp(filters->batch_path, "-") == 0;
+    FILE *file = from_stdin ? stdin : fopen(filters->batch_path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Cannot open the batch file %s.\n", filters->batch_path);
+        return false;
+    }
+
+    char *line = NULL;
+    size_t size = 0;
+    size_t line_number = 0;
+    bool ok = true;
+    while (ok && getline(&line, &size, file) != -1) {
+        ok = add_batch_line(batch, filters, line, ++line_number);
+        if (!ok) {
+            fprintf(stderr, "Memory allocation failed.\n");
+        }
+    }
+    if (ok && ferror(file)) {
+        fprintf(stderr, "Cannot read the batch file %s.\n", filters->batch_path);
+        ok = false;
+    }
+
+    free(line);
+    if (!from_stdin) {
+        fclose(file);
+    }
+    if (!ok) {
+        destroy_batch(batch);
+    }
+    return ok;
+}
+
+void destroy_batch(Batch *batch) {
+    for (size_t i = 0; i < batch->count; i++) {
+        free(batch->queries[i].text);
+        destroy_query(batch->queries[i].filters.query);
+    }
+    free(batch->queries);
+    batch->queries = NULL;
+    batch->count = 0;
+}
+
+bool batch_needs_paths(const Batch *batch) {
+    for (size_t i = 0; i < batch->count; i++) {
+        if (listing_needs_paths(&batch->queries[i].filters)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Writes the listing to its own file in the output directory.
+static bool write_query_file(const char *output, size_t number, const Filters *filters) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/query-%zu.%s", output, number, output_extensions[filters->format]);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot create %s.\n", path);
+        return false;
+    }
+
+    Writer out;
+    bool ok = init_writer(&out, fd);
+    if (!ok) {
+        fprintf(stderr, "Memory allocation failed.\n");
+    } else {
+        ok = print_containers(&out, *filters);
+        if (!flush_writer(&out)) {
+            fprintf(stderr, "Writing %s failed.\n", path);
+            ok = false;
+        }
+        destroy_writer(&out);
+    }
+    close(fd);
+    return ok;
+}
+
+static void render_queries(Writer *out, size_t begin, size_t end, const void *context) {
+    const BatchRun *run = context;
+    for (size_t i = begin; i < end; i++) {
+        const BatchQuery *query = &run->batch->queries[i];
+        if (run->output != NULL) {
+            run->failed[i] = !write_query_file(run->output, i + 1, &query->filters);
+            continue;
+        }
+
+        if (query->filters.format == FORMAT_NDJSON) {
+            write_literal(out, "{\"query\":");
+            write_json_string(out, query->text);
+            write_literal(out, "}\n");
+        } else {
+            write_literal(out, "=== ");
+            write_string(out, query->text);
+            write_char(out, '\n');
+        }
+        run->failed[i] = !print_containers(out, query->filters);
+    }
+}
+
+bool run_batch(Writer *out, const Batch *batch, const char *output, unsigned threads) {
+    BatchRun run = { batch, output, calloc(batch->count + 1, sizeof(bool)) };
+    if (run.failed == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return false;
+    }
+    // Without the indexes, every listing would make its own pass over all containers
+    build_container_indexes();
+
+    bool ok = render_parallel(out, batch->count, threads, render_queries, &run);
+    if (!ok) {
+        fprintf(stderr, "Memory allocation failed.\n");
+    }
+    for (size_t i = 0; i < batch->count; i++) {
+        ok &= !run.failed[i];
+    }
+    free(run.failed);
+    return ok;
+}
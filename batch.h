@@ -0,0 +1,63 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "listing.h"
+#include "writer.h"
+
+/*
+ * Batch of container listings (-b) answered from one load of the data.
+ *
+ * The batch file has one listing per line, given by the options -t, -c, -p,
+ * -f, -q and -a, e.g.
+ *
+ *   -t AP -c 500-2000
+ *   -q 'street ~ "Drozdi"' -f id,capacity
+ *
+ * Empty lines and lines starting with '#' are skipped. Without -o the
+ * outputs are printed in the order of the lines, each after a header line:
+ * "=== <line>" in text, {"query":"<line>"} in ndjson. With -o DIRECTORY the
+ * output of the n-th listing is written to DIRECTORY/query-n.txt, .ndjson
+ * or .cols instead.
+ */
+
+typedef struct {
+    char *text;         // The line as given, without surrounding whitespace
+    Filters filters;
+} BatchQuery;
+
+typedef struct {
+    BatchQuery *queries;
+    size_t count;
+} Batch;
+
+/**
+ * @brief Reads and parses the batch file given by filters->batch_path.
+ *
+ * The lines take -f, --format and the other listing options of the command
+ * line as their defaults. An invalid line ends the program as in parse_args().
+ *
+ * @warning Release the batch by destroy_batch().
+ * @retval false if the file cannot be read or on memory failure.
+ */
+bool load_batch(Batch *batch, const Filters *filters);
+
+// Frees the memory of the batch, including the compiled queries.
+void destroy_batch(Batch *batch);
+
+// Whether any listing of the batch prints path data.
+bool batch_needs_paths(const Batch *batch);
+
+/**
+ * @brief Answers all listings of the batch from the loaded data source.
+ *
+ * Builds the container indexes first, since all listings share them. Up to
+ * threads listings are evaluated at once, each by one thread.
+ *
+ * @param output directory of the output files, or NULL to print to out.
+ * @retval false if any listing failed.
+ */
+bool run_batch(Writer *out, const Batch *batch, const char *output, unsigned threads);
+
+#endif // BATCH_H
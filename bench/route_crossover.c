@@ -0,0 +1,261 @@
+/*
+ * Compares the binary heap of route.c with a linear scan for the closest
+ * unsettled station, as the assignment suggests.
+ *
+ * Runs Dijkstra's algorithm from every station of random connected graphs
+ * of degree 4 and prints the time of one search per station count, as
+ * "stations;linear_ns;linear_sse2_ns;heap_ns". The linear scans keep their
+ * keys in a contiguous array and mask settled stations by INFINITY. Not part
+ * of the build; from the root of the repository:
+ *
+ *   cc -std=c99 -O2 -o route-crossover bench/route_crossover.c \
+ *       $(ls *.c | grep -v '^main\.c$') -lm -lpthread
+ *   ./route-crossover [max_stations]
+ */
+
+#define _DEFAULT_SOURCE
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../route.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Graphs per station count, rounds of searches on each and runs of all rounds per engine.
+#define GRAPHS 16
+#define ROUNDS 1000
+#define RUNS 7
+
+// Edges added from every station, so about twice as many per station in total.
+#define DEGREE 2
+
+typedef size_t (*ArgminFunction)(const double *values, size_t count);
+
+typedef enum {
+    ENGINE_LINEAR,
+    ENGINE_LINEAR_SSE2,
+    ENGINE_HEAP,
+    ENGINES_COUNT
+} Engine;
+
+// Returns the index of the first minimum, or NO_STATION if all values are INFINITY.
+static size_t argmin_scalar(const double *values, size_t count) {
+    size_t best = NO_STATION;
+    double minimum = INFINITY;
+    for (size_t i = 0; i < count; i++) {
+        if (values[i] < minimum) {
+            minimum = values[i];
+            best = i;
+        }
+    }
+    return best;
+}
+
+/* Scans even and odd stations in two lanes at once, each keeping its first
+ * minimum and its index; without SSE2 the scalar scan. */
+static size_t argmin_sse2(const double *values, size_t count) {
+    size_t best = NO_STATION;
+    double minimum = INFINITY;
+    size_t i = 0;
+#ifdef __SSE2__
+    if (count >= 2) {
+        __m128d lane_minimum = _mm_loadu_pd(values);
+        __m128d lane_best = _mm_set_pd(1, 0);
+        __m128d index = lane_best;
+        const __m128d step = _mm_set1_pd(2);
+        for (i = 2; i + 2 <= count; i += 2) {
+            index = _mm_add_pd(index, step);
+            __m128d pair = _mm_loadu_pd(values + i);
+            __m128d lower = _mm_cmplt_pd(pair, lane_minimum);
+            lane_minimum = _mm_min_pd(pair, lane_minimum);
+            lane_best = _mm_or_pd(_mm_and_pd(lower, index), _mm_andnot_pd(lower, lane_best));
+        }
+
+        // Of equal minima the one of the lower index comes first
+        double minima[2];
+        double indices[2];
+        _mm_storeu_pd(minima, lane_minimum);
+        _mm_storeu_pd(indices, lane_best);
+        int lane = minima[1] < minima[0] || (minima[1] == minima[0] && indices[1] < indices[0]);
+        minimum = minima[lane];
+        best = (size_t) indices[lane];
+    }
+#endif
+    for (; i < count; i++) {
+        if (values[i] < minimum) {
+            minimum = values[i];
+            best = i;
+        }
+    }
+    return minimum == INFINITY ? NO_STATION : best;
+}
+
+// Dijkstra's algorithm from the source to all stations by a linear scan; key has a slot per station.
+static void dijkstra_linear(const StationGraph *graph, size_t source, ArgminFunction argmin, double *key,
+                            double *dist) {
+    size_t count = graph->stations_count;
+    for (size_t i = 0; i < count; i++) {
+        dist[i] = INFINITY;
+    }
+    dist[source] = 0;
+    memcpy(key, dist, count * sizeof(double));
+
+    // A settled station keeps its final distance in dist and INFINITY in key
+    size_t u;
+    while ((u = argmin(key, count)) != NO_STATION) {
+        key[u] = INFINITY;
+        for (size_t e = graph->adjacency_offsets[u]; e < graph->adjacency_offsets[u + 1]; e++) {
+            size_t v = graph->adjacency[e];
+            double alt = dist[u] + graph->weights[e];
+            if (alt < dist[v]) {
+                dist[v] = alt;
+                key[v] = alt;
+            }
+        }
+    }
+}
+
+// Builds a connected graph: a random spanning tree and DEGREE - 1 random edges from each station.
+static StationGraph *random_graph(size_t count) {
+    size_t edges = 2 * DEGREE * count;
+    size_t *from = malloc(edges * sizeof(size_t));
+    size_t *to = malloc(edges * sizeof(size_t));
+    double *length = malloc(edges * sizeof(double));
+    size_t *next = malloc((count + 1) * sizeof(size_t));
+    StationGraph *graph = calloc(1, sizeof(StationGraph));
+    if (from == NULL || to == NULL || length == NULL || next == NULL || graph == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t added = 0;
+    for (size_t v = 0; v < count; v++) {
+        for (size_t k = 0; k < DEGREE && count > 1; k++) {
+            size_t u = k == 0 && v > 0 ? (size_t) rand() % v : (size_t) rand() % count;
+            if (u == v) {
+                continue;
+            }
+            double distance = 100 + rand() % 900;
+            from[added] = v, to[added] = u, length[added++] = distance;
+            from[added] = u, to[added] = v, length[added++] = distance;
+        }
+    }
+
+    graph->stations_count = count;
+    graph->adjacency_offsets = calloc(count + 1, sizeof(size_t));
+    graph->adjacency = malloc((added + 1) * sizeof(size_t));
+    graph->weights = malloc((added + 1) * sizeof(double));
+    if (graph->adjacency_offsets == NULL || graph->adjacency == NULL || graph->weights == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t e = 0; e < added; e++) {
+        graph->adjacency_offsets[from[e] + 1]++;
+    }
+    for (size_t v = 0; v < count; v++) {
+        graph->adjacency_offsets[v + 1] += graph->adjacency_offsets[v];
+    }
+    memcpy(next, graph->adjacency_offsets, count * sizeof(size_t));
+    for (size_t e = 0; e < added; e++) {
+        graph->adjacency[next[from[e]]] = to[e];
+        graph->weights[next[from[e]]++] = length[e];
+    }
+
+    free(next);
+    free(from);
+    free(to);
+    free(length);
+    return graph;
+}
+
+static void free_graph(StationGraph *graph) {
+    free(graph->adjacency_offsets);
+    free(graph->adjacency);
+    free(graph->weights);
+    free(graph);
+}
+
+static void search(const StationGraph *graph, size_t source, Engine engine, double *key, double *dist,
+                   size_t *prev) {
+    if (engine == ENGINE_HEAP) {
+        if (!shortest_paths(graph, source, NO_STATION, dist, prev)) {
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        dijkstra_linear(graph, source, engine == ENGINE_LINEAR ? argmin_scalar : argmin_sse2, key, dist);
+    }
+}
+
+static double now_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+// Nanoseconds of one search from every station in turn, over all graphs.
+static double time_engine(StationGraph *const *graphs, Engine engine, double *key, double *dist, size_t *prev) {
+    double start = now_ns();
+    for (size_t g = 0; g < GRAPHS; g++) {
+        for (size_t round = 0; round < ROUNDS; round++) {
+            search(graphs[g], round % graphs[g]->stations_count, engine, key, dist, prev);
+        }
+    }
+    return (now_ns() - start) / (GRAPHS * ROUNDS);
+}
+
+int main(int argc, char *argv[]) {
+    size_t max_stations = argc > 1 ? (size_t) strtoul(argv[1], NULL, 10) : 32;
+    double *key = malloc((max_stations + 1) * sizeof(double));
+    double *dist = malloc((max_stations + 1) * sizeof(double));
+    double *check = malloc((max_stations + 1) * sizeof(double));
+    size_t *prev = malloc((max_stations + 1) * sizeof(size_t));
+    if (key == NULL || dist == NULL || check == NULL || prev == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return EXIT_FAILURE;
+    }
+
+    srand(1);
+    printf("stations;linear_ns;linear_sse2_ns;heap_ns\n");
+    for (size_t count = 2; count <= max_stations; count++) {
+        StationGraph *graphs[GRAPHS];
+        for (size_t g = 0; g < GRAPHS; g++) {
+            graphs[g] = random_graph(count);
+
+            // The engines must agree before their times mean anything
+            for (size_t source = 0; source < count; source++) {
+                search(graphs[g], source, ENGINE_HEAP, key, check, prev);
+                for (Engine engine = ENGINE_LINEAR; engine < ENGINE_HEAP; engine++) {
+                    search(graphs[g], source, engine, key, dist, prev);
+                    if (memcmp(check, dist, count * sizeof(double)) != 0) {
+                        fprintf(stderr, "The engines disagree on a graph of %zu stations.\n", count);
+                        return EXIT_FAILURE;
+                    }
+                }
+            }
+        }
+
+        // The best of alternating runs, which filters out the noise of other processes
+        double best[ENGINES_COUNT] = { INFINITY, INFINITY, INFINITY };
+        for (int run = 0; run < RUNS; run++) {
+            for (Engine engine = ENGINE_LINEAR; engine < ENGINES_COUNT; engine++) {
+                best[engine] = fmin(best[engine], time_engine(graphs, engine, key, dist, prev));
+            }
+        }
+        printf("%zu;%.0f;%.0f;%.0f\n", count, best[ENGINE_LINEAR], best[ENGINE_LINEAR_SSE2], best[ENGINE_HEAP]);
+
+        for (size_t g = 0; g < GRAPHS; g++) {
+            free_graph(graphs[g]);
+        }
+    }
+
+    free(key);
+    free(dist);
+    free(check);
+    free(prev);
+    return EXIT_SUCCESS;
+}
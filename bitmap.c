@@ -0,0 +1,88 @@
+#include "bitmap.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BITMAP_X86_SIMD 1
+#endif
+
+uint64_t *create_bitmap(size_t bits) {
+    // One spare word keeps the allocation non-empty for zero bits
+    return calloc(bitmap_words(bits) + 1, sizeof(uint64_t));
+}
+
+void bitmap_fill(uint64_t *bitmap, size_t bits) {
+    size_t full = bits / BITMAP_WORD_BITS;
+    memset(bitmap, 0xff, full * sizeof(uint64_t));
+    if (bits % BITMAP_WORD_BITS != 0) {
+        bitmap[full] = ((uint64_t) 1 << (bits % BITMAP_WORD_BITS)) - 1;
+    }
+}
+
+#ifdef BITMAP_X86_SIMD
+__attribute__((target("avx2")))
+static void bitmap_or_avx2(uint64_t *target, const uint64_t *source, size_t words) {
+    size_t i = 0;
+    for (; i + 4 <= words; i += 4) {
+        __m256i merged = _mm256_or_si256(_mm256_loadu_si256((const __m256i *) (target + i)),
+                                         _mm256_loadu_si256((const __m256i *) (source + i)));
+        _mm256_storeu_si256((__m256i *) (target + i), merged);
+    }
+    for (; i < words; i++) {
+        target[i] |= source[i];
+    }
+}
+
+__attribute__((target("avx2")))
+static void bitmap_and_avx2(uint64_t *target, const uint64_t *source, size_t words) {
+    size_t i = 0;
+    for (; i + 4 <= words; i += 4) {
+        __m256i merged = _mm256_and_si256(_mm256_loadu_si256((const __m256i *) (target + i)),
+                                          _mm256_loadu_si256((const __m256i *) (source + i)));
+        _mm256_storeu_si256((__m256i *) (target + i), merged);
+    }
+    for (; i < words; i++) {
+        target[i] &= source[i];
+    }
+}
+#endif
+
+// Without AVX2 the plain loops are left to the auto-vectorizer of the compiler.
+void bitmap_or(uint64_t *target, const uint64_t *source, size_t words) {
+#ifdef BITMAP_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        bitmap_or_avx2(target, source, words);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < words; i++) {
+        target[i] |= source[i];
+    }
+}
+
+void bitmap_and(uint64_t *target, const uint64_t *source, size_t words) {
+#ifdef BITMAP_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        bitmap_and_avx2(target, source, words);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < words; i++) {
+        target[i] &= source[i];
+    }
+}
+
+// Each set bit is taken by counting trailing zeros and cleared with word & (word - 1).
+size_t bitmap_to_rows(const uint64_t *bitmap, size_t words, size_t *rows) {
+    size_t count = 0;
+    for (size_t i = 0; i < words; i++) {
+        uint64_t word = bitmap[i];
+        while (word != 0) {
+            rows[count++] = i * BITMAP_WORD_BITS + (size_t) __builtin_ctzll(word);
+            word &= word - 1;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,49 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Bitmaps over container rows: bit r of the bitmap is bit r % 64 of word
+ * r / 64. Bits past the last row are kept clear, so the set bits of a whole
+ * word can be counted and iterated without looking at the row count.
+ */
+
+#define BITMAP_WORD_BITS 64
+
+// Returns the count of words holding the given count of bits.
+static inline size_t bitmap_words(size_t bits) {
+    return (bits + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS;
+}
+
+static inline void bitmap_set(uint64_t *bitmap, size_t bit) {
+    bitmap[bit / BITMAP_WORD_BITS] |= (uint64_t) 1 << (bit % BITMAP_WORD_BITS);
+}
+
+static inline bool bitmap_test(const uint64_t *bitmap, size_t bit) {
+    return (bitmap[bit / BITMAP_WORD_BITS] >> (bit % BITMAP_WORD_BITS)) & 1;
+}
+
+// Allocates a bitmap of the given count of bits, all clear; NULL on memory failure.
+uint64_t *create_bitmap(size_t bits);
+
+// Sets the first bits of the bitmap and clears the rest of its words.
+void bitmap_fill(uint64_t *bitmap, size_t bits);
+
+// target |= source, word by word.
+void bitmap_or(uint64_t *target, const uint64_t *source, size_t words);
+
+// target &= source, word by word.
+void bitmap_and(uint64_t *target, const uint64_t *source, size_t words);
+
+/**
+ * @brief Lists the positions of the set bits in ascending order.
+ *
+ * @param rows receives the positions, must hold all set bits.
+ * @retval size_t count of the set bits.
+ */
+size_t bitmap_to_rows(const uint64_t *bitmap, size_t words, size_t *rows);
+
+#endif // BITMAP_H
@@ -0,0 +1,121 @@
+#include "columnar.h"
+
+#include <string.h>
+
+// Sections start at multiples of this many bytes.
+#define SECTION_ALIGNMENT 8
+
+static const uint64_t zero_offset = 0;
+
+void init_columnar_table(ColumnarTable *table) {
+    table->rows = 0;
+    table->columns_count = 0;
+}
+
+void destroy_columnar_table(ColumnarTable *table) {
+    for (size_t i = 0; i < table->columns_count; i++) {
+        destroy_writer(&table->columns[i].lists);
+        destroy_writer(&table->columns[i].values);
+        destroy_writer(&table->columns[i].bytes);
+    }
+    table->columns_count = 0;
+}
+
+Column *add_column(ColumnarTable *table, const char *name, ColumnKind kind) {
+    if (table->columns_count >= COLUMNS_MAX) {
+        return NULL;
+    }
+
+    Column *column = &table->columns[table->columns_count];
+    memset(column, 0, sizeof(Column));
+    strncpy(column->name, name, COLUMN_NAME_SIZE - 1);
+    column->kind = kind;
+    if (!init_writer(&column->lists, -1) || !init_writer(&column->values, -1) || !init_writer(&column->bytes, -1)) {
+        destroy_writer(&column->lists);
+        destroy_writer(&column->values);
+        destroy_writer(&column->bytes);
+        return NULL;
+    }
+    table->columns_count++;
+
+    // Offset sections start with the beginning of the first row
+    if (kind == COLUMN_U64_LIST || kind == COLUMN_STRING_LIST) {
+        write_bytes(&column->lists, (const char *) &zero_offset, sizeof(uint64_t));
+    }
+    if (kind == COLUMN_STRING || kind == COLUMN_STRING_LIST) {
+        write_bytes(&column->values, (const char *) &zero_offset, sizeof(uint64_t));
+    }
+    return column;
+}
+
+void append_u64(Column *column, uint64_t value) {
+    write_bytes(&column->values, (const char *) &value, sizeof(uint64_t));
+    column->items++;
+}
+
+void end_string(Column *column) {
+    uint64_t end = column->bytes.length;
+    write_bytes(&column->values, (const char *) &end, sizeof(uint64_t));
+    column->items++;
+}
+
+void end_list(Column *column) {
+    write_bytes(&column->lists, (const char *) &column->items, sizeof(uint64_t));
+}
+
+static size_t align(size_t offset) {
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+// Places the section at the offset, moving the offset after it; empty sections are absent.
+static uint64_t place_section(const Writer *section, size_t *offset) {
+    if (section->length == 0) {
+        return 0;
+    }
+    uint64_t start = *offset;
+    *offset = align(*offset + section->length);
+    return start;
+}
+
+static void write_section(Writer *out, const Writer *section) {
+    static const char padding[SECTION_ALIGNMENT] = { 0 };
+    write_bytes(out, section->data, section->length);
+    write_bytes(out, padding, align(section->length) - section->length);
+}
+
+bool write_columnar_table(Writer *out, const ColumnarTable *table) {
+    // Nothing is written for a table that is not complete
+    for (size_t i = 0; i < table->columns_count; i++) {
+        const Column *column = &table->columns[i];
+        if (column->lists.failed || column->values.failed || column->bytes.failed) {
+            return false;
+        }
+    }
+
+    ColumnarHeader header;
+    memcpy(header.magic, COLUMNAR_MAGIC, sizeof(header.magic));
+    header.rows = table->rows;
+    header.columns_count = table->columns_count;
+    write_bytes(out, (const char *) &header, sizeof(header));
+
+    size_t offset = sizeof(ColumnarHeader) + table->columns_count * sizeof(ColumnDescriptor);
+    for (size_t i = 0; i < table->columns_count; i++) {
+        const Column *column = &table->columns[i];
+        ColumnDescriptor descriptor;
+        memset(&descriptor, 0, sizeof(descriptor));
+        memcpy(descriptor.name, column->name, COLUMN_NAME_SIZE);
+        descriptor.kind = column->kind;
+        descriptor.lists = place_section(&column->lists, &offset);
+        descriptor.values = place_section(&column->values, &offset);
+        descriptor.bytes = place_section(&column->bytes, &offset);
+        descriptor.bytes_length = column->bytes.length;
+        write_bytes(out, (const char *) &descriptor, sizeof(descriptor));
+    }
+
+    for (size_t i = 0; i < table->columns_count; i++) {
+        write_section(out, &table->columns[i].lists);
+        write_section(out, &table->columns[i].values);
+        write_section(out, &table->columns[i].bytes);
+    }
+    return !out->failed;
+}
@@ -0,0 +1,120 @@
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "writer.h"
+
+/*
+ * Binary columnar output, meant to be mapped into memory as is.
+ *
+ * All integers are 64-bit in the byte order of the producing machine and
+ * every section starts at a multiple of 8 bytes. The file starts with
+ * a ColumnarHeader followed by columns_count ColumnDescriptors. Each column
+ * consists of up to three sections, given as absolute file offsets
+ * (0 = not present):
+ *
+ *   COLUMN_U64          values: rows integers
+ *   COLUMN_STRING       values: rows + 1 end offsets into bytes, starting with 0
+ *                       bytes: string heap, strings are not null-terminated
+ *   COLUMN_U64_LIST     lists: rows + 1 offsets into values, starting with 0
+ *                       values: the list items
+ *   COLUMN_STRING_LIST  lists: rows + 1 offsets into the string items
+ *                       values, bytes: string items as in COLUMN_STRING
+ *
+ * Row r of a string column is bytes[values[r]] up to bytes[values[r + 1] - 1],
+ * the items of a list row r are items lists[r] up to lists[r + 1] - 1.
+ */
+
+#define COLUMNAR_MAGIC "CECOLS01"
+
+// Longest column name, including the terminating null character.
+#define COLUMN_NAME_SIZE 16
+
+// Most columns a table can have.
+#define COLUMNS_MAX 8
+
+typedef enum {
+    COLUMN_U64 = 1,
+    COLUMN_STRING,
+    COLUMN_U64_LIST,
+    COLUMN_STRING_LIST
+} ColumnKind;
+
+typedef struct {
+    char magic[8];
+    uint64_t rows;
+    uint64_t columns_count;
+} ColumnarHeader;
+
+typedef struct {
+    char name[COLUMN_NAME_SIZE];
+    uint32_t kind;              // ColumnKind
+    uint32_t reserved;
+    uint64_t lists;
+    uint64_t values;
+    uint64_t bytes;
+    uint64_t bytes_length;
+} ColumnDescriptor;
+
+// A column being filled, each section collected in a memory writer.
+typedef struct {
+    char name[COLUMN_NAME_SIZE];
+    ColumnKind kind;
+    Writer lists;
+    Writer values;
+    Writer bytes;
+    uint64_t items;             // Items appended to a list column so far
+} Column;
+
+typedef struct {
+    size_t rows;
+    size_t columns_count;
+    Column columns[COLUMNS_MAX];
+} ColumnarTable;
+
+// Prepares an empty table.
+void init_columnar_table(ColumnarTable *table);
+
+// Frees the memory held by the columns of the table.
+void destroy_columnar_table(ColumnarTable *table);
+
+/**
+ * @brief Adds a column to the table.
+ *
+ * @param name at most COLUMN_NAME_SIZE - 1 characters.
+ * @retval Column* the added column, to be filled row by row.
+ * @retval NULL on memory failure.
+ */
+Column *add_column(ColumnarTable *table, const char *name, ColumnKind kind);
+
+// Appends an integer to a COLUMN_U64 row or an item to a COLUMN_U64_LIST row.
+void append_u64(Column *column, uint64_t value);
+
+// Appends a part of the string being built, finished by end_string().
+static inline void append_string_part(Column *column, const char *part, size_t length) {
+    write_bytes(&column->bytes, part, length);
+}
+
+// Finishes a string of a COLUMN_STRING row or an item of a COLUMN_STRING_LIST row.
+void end_string(Column *column);
+
+// Appends a string to a COLUMN_STRING row or an item to a COLUMN_STRING_LIST row.
+static inline void append_string(Column *column, const char *string, size_t length) {
+    append_string_part(column, string, length);
+    end_string(column);
+}
+
+// Closes the current row of a list column.
+void end_list(Column *column);
+
+/**
+ * @brief Writes the table of table->rows rows to the output.
+ *
+ * @retval false if a column could not be filled due to memory failure,
+ * in which case nothing is written.
+ */
+bool write_columnar_table(Writer *out, const ColumnarTable *table);
+
+#endif // COLUMNAR_H
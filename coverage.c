@@ -0,0 +1,199 @@
+#include "coverage.h"
+#include "dataset.h"
+#include "route.h"
+#include "stations.h"
+#include "scheduler.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// One multi-source search from all stations offering a waste type.
+typedef struct {
+    const StationGraph *graph;
+    int type;
+    double *dist;
+    bool ok;
+} TypeSearch;
+
+// Parses the list of 1-based station IDs into 0-based station indices.
+static size_t *parse_station_list(const char *list, size_t stations_count, size_t *count) {
+    size_t capacity = 1;
+    for (const char *c = list; *c != '\0'; c++) {
+        capacity += *c == ',';
+    }
+
+    size_t *stations = malloc(capacity * sizeof(size_t));
+    if (stations == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return NULL;
+    }
+
+    *count = 0;
+    const char *position = list;
+    while (*count < capacity) {
+        char *end;
+        unsigned long id = strtoul(position, &end, 10);
+        if (end == position || id == 0 || id > stations_count || (*end != ',' && *end != '\0')) {
+            fprintf(stderr, "Station does not exist.\n");
+            free(stations);
+            return NULL;
+        }
+        stations[(*count)++] = id - 1;
+        position = end + 1;
+    }
+    return stations;
+}
+
+bool print_depot_partition(Writer *out, const char *depots) {
+    const StationGraph *graph = get_station_graph();
+    if (graph == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return false;
+    }
+
+    size_t depots_count;
+    size_t *sources = parse_station_list(depots, graph->stations_count, &depots_count);
+    if (sources == NULL) {
+        return false;
+    }
+
+    size_t count = graph->stations_count;
+    double *dist = malloc((count + 1) * sizeof(double));
+    size_t *origin = malloc((count + 1) * sizeof(size_t));
+    unsigned long *totals = calloc(depots_count * WASTE_TYPES_COUNT, sizeof(unsigned long));
+    if (dist == NULL || origin == NULL || totals == NULL
+        || !nearest_sources(graph, sources, depots_count, dist, origin)) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        free(dist);
+        free(origin);
+        free(totals);
+        free(sources);
+        return false;
+    }
+
+    for (size_t s = 0; s < count; s++) {
+        write_uint(out, s + 1);
+        if (origin[s] == NO_STATION) {
+            write_literal(out, "->- -\n");
+            continue;
+        }
+        write_literal(out, "->");
+        write_uint(out, sources[origin[s]] + 1);
+        write_char(out, ' ');
+        write_distance(out, dist[s]);
+        write_char(out, '\n');
+        for (int type = 0; type < WASTE_TYPES_COUNT; type++) {
+            totals[origin[s] * WASTE_TYPES_COUNT + type] += graph->capacity[s * WASTE_TYPES_COUNT + type];
+        }
+    }
+
+    // A depot listed twice owns nothing under its second index
+    for (size_t d = 0; d < depots_count; d++) {
+        if (origin[sources[d]] != d) {
+            continue;
+        }
+        write_uint(out, sources[d] + 1);
+        for (int type = 0; type < WASTE_TYPES_COUNT; type++) {
+            write_char(out, ';');
+            write_char(out, WASTE_TYPE_ORDER[type]);
+            write_char(out, ':');
+            write_uint(out, totals[d * WASTE_TYPES_COUNT + type]);
+        }
+        write_char(out, '\n');
+    }
+
+    free(dist);
+    free(origin);
+    free(totals);
+    free(sources);
+    return true;
+}
+
+static void search_type(TypeSearch *search) {
+    const StationGraph *graph = search->graph;
+    size_t count = graph->stations_count;
+    size_t *sources = malloc((count + 1) * sizeof(size_t));
+    size_t *origin = malloc((count + 1) * sizeof(size_t));
+    if (sources == NULL || origin == NULL) {
+        free(sources);
+        free(origin);
+        search->ok = false;
+        return;
+    }
+
+    size_t sources_count = 0;
+    for (size_t s = 0; s < count; s++) {
+        if (graph->waste_mask[s] & (1u << search->type)) {
+            sources[sources_count++] = s;
+        }
+    }
+
+    if (sources_count == 0) {
+        for (size_t s = 0; s < count; s++) {
+            search->dist[s] = INFINITY;
+        }
+        search->ok = true;
+    } else {
+        search->ok = nearest_sources(graph, sources, sources_count, search->dist, origin);
+    }
+
+    free(sources);
+    free(origin);
+}
+
+static void search_types(size_t begin, size_t end, void *context) {
+    TypeSearch *searches = context;
+    for (size_t type = begin; type < end; type++) {
+        search_type(&searches[type]);
+    }
+}
+
+bool print_type_accessibility(Writer *out) {
+    const StationGraph *graph = get_station_graph();
+    if (graph == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return false;
+    }
+
+    size_t count = graph->stations_count;
+    double *dist = malloc((count + 1) * WASTE_TYPES_COUNT * sizeof(double));
+    if (dist == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return false;
+    }
+
+    // The searches of the types are independent of each other
+    TypeSearch searches[WASTE_TYPES_COUNT];
+    for (int type = 0; type < WASTE_TYPES_COUNT; type++) {
+        searches[type] = (TypeSearch) { graph, type, dist + type * count, false };
+    }
+    parallel_for(WASTE_TYPES_COUNT, 1, search_types, searches);
+
+    bool ok = true;
+    for (int type = 0; type < WASTE_TYPES_COUNT; type++) {
+        ok &= searches[type].ok;
+    }
+    if (!ok) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        free(dist);
+        return false;
+    }
+
+    for (size_t s = 0; s < count; s++) {
+        write_uint(out, s + 1);
+        for (int type = 0; type < WASTE_TYPES_COUNT; type++) {
+            double distance = dist[type * count + s];
+            write_char(out, ';');
+            if (distance == INFINITY) {
+                write_char(out, '-');
+            } else {
+                write_distance(out, distance);
+            }
+        }
+        write_char(out, '\n');
+    }
+
+    free(dist);
+    return true;
+}
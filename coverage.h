@@ -0,0 +1,33 @@
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include <stdbool.h>
+
+#include "writer.h"
+
+/**
+ * @brief Assigns every station to its nearest depot by road distance.
+ *
+ * Prints one line `STATION->DEPOT DISTANCE` per station (`STATION->- -` for
+ * stations no depot can reach), followed by one line per depot with the total
+ * capacity of the assigned containers by waste type:
+ * `DEPOT;A:capacity;P:capacity;B:capacity;G:capacity;C:capacity;T:capacity`.
+ *
+ * @param depots comma separated list of depot station IDs, e.g. "1,5".
+ * @retval false if a depot does not exist or on memory failure.
+ */
+bool print_depot_partition(Writer *out, const char *depots);
+
+/**
+ * @brief Prints the road distance from every station to the nearest station
+ * offering each waste type.
+ *
+ * Prints one line `STATION;A;P;B;G;C;T` per station with the distances in
+ * the order of WASTE_TYPE_ORDER, `-` if no station of the type is reachable.
+ * The six searches run concurrently.
+ *
+ * @retval false on memory or thread failure.
+ */
+bool print_type_accessibility(Writer *out);
+
+#endif // COVERAGE_H
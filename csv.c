@@ -0,0 +1,236 @@
+#define _DEFAULT_SOURCE
+#include "csv.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "scheduler.h"
+
+void free_csv_table(CsvTable *table) {
+    free(table->strings);
+    free(table->fields);
+    table->strings = NULL;
+    table->fields = NULL;
+    table->strings_length = table->count = 0;
+}
+
+// Appends the field with its '\0' to the strings of the table and stores its offset.
+static bool append_field(CsvTable *table, size_t *strings_capacity, const char *field, size_t *offset) {
+    size_t length = strlen(field) + 1;
+    if (table->strings_length + length > *strings_capacity) {
+        size_t capacity = *strings_capacity * 2 + length;
+        char *strings = realloc(table->strings, capacity);
+        if (strings == NULL) {
+            return false;
+        }
+        table->strings = strings;
+        *strings_capacity = capacity;
+    }
+    memcpy(table->strings + table->strings_length, field, length);
+    *offset = table->strings_length;
+    table->strings_length += length;
+    return true;
+}
+
+// Stores the expected_count fields of the line at fields; false if the line has another count.
+static bool split_csv_line(char *line, size_t expected_count, CsvTable *table, size_t *strings_capacity,
+                           size_t *fields) {
+    assert(line != NULL);
+
+    size_t line_length = strlen(line);
+
+    char *state;
+    char *token = strtok_r(line, ",", &state);
+    size_t parsed_length = 0;
+
+    for (size_t index = 0; index < expected_count; index++) {
+        if (token == NULL) {
+            return false;
+        }
+
+        parsed_length += strlen(token) + 1;
+
+        if (!append_field(table, strings_capacity, token, &fields[index])) {
+            return false;
+        }
+
+        if (line_length > parsed_length
+            && strchr(line + parsed_length, ',') == line + parsed_length) {
+            token = "";
+        } else {
+            token = strtok_r(NULL, ",", &state);
+        }
+    }
+
+    return token == NULL;
+}
+
+bool start_csv(CsvParser *parser, CsvTable *table, size_t column_count) {
+    *parser = (CsvParser) { table, column_count, 8, 0, 0 };
+    *table = (CsvTable) { NULL, 0, malloc(parser->lines_capacity * column_count * sizeof(size_t)), 0 };
+    return table->fields != NULL;
+}
+
+// Makes room for the offsets of one more line.
+static bool reserve_line(CsvParser *parser) {
+    CsvTable *table = parser->table;
+    if (table->count < parser->lines_capacity) {
+        return true;
+    }
+    void *tmp = realloc(table->fields, parser->lines_capacity * 2 * parser->column_count * sizeof(size_t));
+    if (tmp == NULL) {
+        return false;
+    }
+    table->fields = tmp;
+    parser->lines_capacity *= 2;
+    return true;
+}
+
+bool parse_csv_lines(CsvParser *parser, LoadedFile *file) {
+    CsvTable *table = parser->table;
+    size_t column_count = parser->column_count;
+
+    while (parser->position < file->arrived) {
+        char *line = file->data + parser->position;
+        char *end = memchr(line, '\n', file->arrived - parser->position);
+        if (end == NULL) {
+            break;
+        }
+        *end = '\0';
+        parser->position = (size_t) (end - file->data) + 1;
+
+        if (!reserve_line(parser)
+            || !split_csv_line(line, column_count, table, &parser->strings_capacity,
+                               table->fields + table->count * column_count)) {
+            return false;
+        }
+        table->count++;
+    }
+    return true;
+}
+
+bool parse_csv(const char *path, size_t column_count, CsvTable *table) {
+    Loader *loader = start_loading(&path, 1);
+    CsvParser parser;
+    bool ok = start_csv(&parser, table, column_count) && loader != NULL;
+    while (ok) {
+        LoadedFile *file = loaded_file(loader, 0);
+        ok = !file->failed && parse_csv_lines(&parser, file);
+        if (!wait_for_loading(loader)) {
+            break;
+        }
+    }
+
+    if (loader != NULL) {
+        char *data = loaded_file(loader, 0)->data;
+        finish_loading(loader);
+        free(data);
+    }
+    if (!ok) {
+        free_csv_table(table);
+    }
+    return ok;
+}
+
+// A file parsed as a task of its own.
+typedef struct {
+    const char *path;
+    size_t column_count;
+    CsvTable *table;
+    bool ok;
+} CsvJob;
+
+static void run_csv_jobs(size_t begin, size_t end, void *context) {
+    CsvJob *jobs = context;
+    for (size_t i = begin; i < end; i++) {
+        jobs[i].ok = parse_csv(jobs[i].path, jobs[i].column_count, jobs[i].table);
+    }
+}
+
+bool parse_input_files(const char *containers_path, const char *paths_path, CsvTable *containers, CsvTable *paths) {
+    // The files are independent of each other, so they are parsed in parallel
+    CsvJob jobs[] = { { containers_path, CONTAINER_COLUMNS_COUNT, containers, false },
+                      { paths_path, PATH_COLUMNS_COUNT, paths, true } };
+    parallel_for(paths_path != NULL ? 2 : 1, 1, run_csv_jobs, jobs);
+
+    if (!jobs[0].ok) {
+        fprintf(stderr, "Invalid File %s.\n", containers_path);
+    }
+    // A broken paths file fails silently
+    if (!jobs[0].ok || !jobs[1].ok) {
+        free_csv_table(containers);
+        free_csv_table(paths);
+        return false;
+    }
+    return true;
+}
+
+bool parse_csv_blocks(const char *path, size_t column_count, CsvBlockConsumer consume, void *context) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    size_t capacity = CSV_BLOCK_SIZE;
+    size_t length = 0;
+    char *block = malloc(capacity);
+    bool ok = fd >= 0 && block != NULL;
+    size_t lines = 0;
+    bool end = false;
+    while (ok && !end) {
+        ssize_t count = read(fd, block + length, capacity - length);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        ok = count >= 0;
+        end = count <= 0;
+        length += ok ? (size_t) count : 0;
+
+        CsvTable table;
+        CsvParser parser;
+        LoadedFile file = { block, length, length, false };
+        ok = ok && start_csv(&parser, &table, column_count);
+        if (!ok) {
+            break;
+        }
+        ok = parse_csv_lines(&parser, &file) && consume(&table, lines, context);
+        lines += table.count;
+        free_csv_table(&table);
+
+        // The rest of the last line starts the block again; a longer line grows it
+        length -= parser.position;
+        memmove(block, block + parser.position, length);
+        if (ok && length == capacity) {
+            char *grown = realloc(block, capacity * 2);
+            ok = grown != NULL;
+            if (ok) {
+                block = grown;
+                capacity *= 2;
+            }
+        }
+    }
+    free(block);
+    if (fd >= 0) {
+        close(fd);
+    }
+    return ok;
+}
+
+bool parse_numeric_id(const char *id, uint32_t *value) {
+    if (id[0] == '\0' || (id[0] == '0' && id[1] != '\0')) {
+        return false;
+    }
+    uint64_t number = 0;
+    for (const char *c = id; *c != '\0'; c++) {
+        if (*c < '0' || *c > '9') {
+            return false;
+        }
+        number = number * 10 + (uint64_t) (*c - '0');
+        if (number > INT_MAX) {
+            return false;
+        }
+    }
+    *value = (uint32_t) number;
+    return true;
+}
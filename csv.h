@@ -0,0 +1,113 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "loader.h"
+
+// Container CSV column header
+#define CONTAINER_COLUMNS_COUNT 9
+
+#define CONTAINER_ID 0
+#define CONTAINER_X 1
+#define CONTAINER_Y 2
+#define CONTAINER_WASTE_TYPE 3
+#define CONTAINER_CAPACITY 4
+#define CONTAINER_NAME 5
+#define CONTAINER_STREET 6
+#define CONTAINER_NUMBER 7
+#define CONTAINER_PUBLIC 8
+
+// Path CSV column header
+#define PATH_COLUMNS_COUNT 3
+
+#define PATH_A 0
+#define PATH_B 1
+#define PATH_DISTANCE 2
+
+// Decimal digits of the largest numeric ID, INT_MAX.
+#define NUMERIC_ID_DIGITS 10
+
+/* Fields of the lines of a CSV file. The fields are kept in one block of
+ * strings and found by their offsets, so the table holds no pointers into
+ * itself and can be stored and mapped as it is. */
+typedef struct {
+    char *strings;          // The fields, each terminated by '\0'
+    size_t strings_length;
+    size_t *fields;         // Offsets of the fields in strings, the columns of each line in turn
+    size_t count;           // Lines
+} CsvTable;
+
+// Size a file is read in by parse_csv_blocks().
+#define CSV_BLOCK_SIZE (1024 * 1024)
+
+// A CSV table filled line by line, e.g. while its file arrives.
+typedef struct {
+    CsvTable *table;
+    size_t column_count;
+    size_t lines_capacity;
+    size_t strings_capacity;
+    size_t position;            // Start of the first line not parsed yet
+} CsvParser;
+
+// Returns the field of the line of a table with the given count of columns.
+static inline const char *csv_field(const CsvTable *table, size_t column_count, size_t line, size_t column) {
+    return table->strings + table->fields[line * column_count + column];
+}
+
+// Frees the fields and leaves the table empty.
+void free_csv_table(CsvTable *table);
+
+// Starts an empty table; false on memory failure.
+bool start_csv(CsvParser *parser, CsvTable *table, size_t column_count);
+
+/**
+ * @brief Parses the complete lines of the arrived part of the file, which
+ * is modified in place; a last line without '\n' is left for the next call.
+ *
+ * @retval false if a line has another count of columns or on memory failure.
+ */
+bool parse_csv_lines(CsvParser *parser, LoadedFile *file);
+
+/**
+ * @brief Reads the file and parses its lines as they arrive, see loader.h.
+ *
+ * @retval false if it cannot be read, a line is invalid or on memory failure;
+ * the table is then empty.
+ */
+bool parse_csv(const char *path, size_t column_count, CsvTable *table);
+
+/**
+ * @brief Parses the containers and the paths file, in parallel.
+ *
+ * @param paths_path NULL to leave the paths empty.
+ * @retval false if a file cannot be read, a line is invalid or on memory
+ * failure, with a message for the containers file only; both tables are
+ * then empty.
+ */
+bool parse_input_files(const char *containers_path, const char *paths_path, CsvTable *containers, CsvTable *paths);
+
+// Receives the lines of a block, the first being line first_line + 1 of the file; false stops the parsing.
+typedef bool (*CsvBlockConsumer)(const CsvTable *lines, size_t first_line, void *context);
+
+/**
+ * @brief Reads the file in blocks of whole lines, parsed and handed to
+ * consume one block at a time, so that memory use does not grow with the
+ * file. A block is grown for a line longer than CSV_BLOCK_SIZE.
+ *
+ * @retval false if it cannot be read, a line is invalid, on memory failure
+ * or if consume returns false.
+ */
+bool parse_csv_blocks(const char *path, size_t column_count, CsvBlockConsumer consume, void *context);
+
+/**
+ * @brief Reads an ID written as a number without leading zeros and no
+ * larger than INT_MAX, so that it is written back the same and sorts as by
+ * atoi().
+ *
+ * @retval false for any other ID.
+ */
+bool parse_numeric_id(const char *id, uint32_t *value);
+
+#endif // CSV_H
@@ -172,22 +172,4 @@ const char *get_path_b_id(size_t line_index);
  */
 const char *get_path_distance(size_t line_index);
 
-typedef struct {
-    char waste_types[8][2];
-    size_t waste_type_count;
-    int capacity_min;
-    int capacity_max;
-    int public_filter;
-    const char *containers_path;
-    const char *paths_path;
-    int special_flag;
-} Filters;
-
-
-// Update the function prototype
-void print_containers(Filters filters);
-void print_locations(void);
-void print_stations(void);
-char get_waste_type_char(const char *type);
-char* set_order(char* waste_types);
 #endif // DATA_SOURCE_H
@@ -0,0 +1,591 @@
+#define _DEFAULT_SOURCE
+#include "dataset.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bitmap.h"
+#include "snapshot.h"
+
+typedef struct {
+    int capacity;
+    size_t row;
+} CapacityEntry;
+
+struct dataset {
+    CsvTable containers;
+    CsvTable paths;
+
+    // Edges between the IDs of the paths, sorted in a temporary file; only of a streamed batch
+    EdgeFile *neighbor_edges;
+
+    // Filtered columns of the containers, extracted at load time
+    ContainerColumns columns;
+
+    // Indexes for repeated queries, built by build_container_indexes()
+    uint64_t *type_bitmaps[WASTE_TYPES_COUNT];  // Indexed as WASTE_TYPE_ORDER
+    uint64_t *public_bitmaps[2];                // [0] not public (N), [1] public (Y)
+    CapacityEntry *capacity_index;              // All rows sorted by capacity, then by row
+
+    StationGraph *station_graph;                // Built by the first get_station_graph()
+    char *paths_path;                           // File the station graph streams the paths from if they are not held
+
+    // Snapshot holding the arrays above when attached by attach_dataset(), otherwise NULL
+    char *snapshot;
+    size_t snapshot_size;
+};
+
+// Identifies snapshots of the data, written last so that a partial snapshot is rejected.
+#define SNAPSHOT_MAGIC "CEDATA01"
+
+// Tells apart the byte order and word size of the publishing machine.
+#define SNAPSHOT_BYTE_ORDER 0x0102030405060708ull
+
+// First array of a snapshot: the counts the other arrays are laid out by.
+typedef struct {
+    char magic[8];
+    uint64_t byte_order;
+    uint64_t size;
+    size_t containers_count;
+    size_t containers_strings_length;
+    size_t paths_count;
+    size_t paths_strings_length;
+    int32_t capacity_lowest;
+    int32_t capacity_highest;
+    size_t stations_count;
+} SnapshotHeader;
+
+/*
+ * Versions of the data. Queries read the published version; a reload builds
+ * the next one aside and swaps the pointer. Each reader announces the epoch
+ * it entered in its slot, so the previous version is freed only once every
+ * reader that could have seen it has left. Readers never take a lock.
+ */
+static struct dataset *published;
+
+// Incremented by every swap of the published version
+static uint64_t current_epoch = 1;
+
+// Epoch each reader entered, 0 outside of enter_dataset(); a cache line per reader
+static struct {
+    uint64_t epoch;
+    char padding[64 - sizeof(uint64_t)];
+} reader_epochs[DATASET_READERS_MAX];
+
+// Version read by this thread while it is pinned by enter_dataset() or being built
+static __thread struct dataset *pinned;
+
+// Serializes the lazy construction of the station graph.
+static pthread_mutex_t station_graph_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline struct dataset *current(void) {
+    return pinned != NULL ? pinned : __atomic_load_n(&published, __ATOMIC_ACQUIRE);
+}
+
+static int compare_ids(const void *a, const void *b) {
+    unsigned long first = *(const unsigned long *) a;
+    unsigned long second = *(const unsigned long *) b;
+    return (first > second) - (first < second);
+}
+
+// Checks that every path connects two containers of the file, like the stations match them by ID.
+static bool validate_paths(const struct dataset *data, const char *paths_path) {
+    size_t count = data->containers.count;
+    unsigned long *ids = malloc((count + 1) * sizeof(unsigned long));
+    if (ids == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return false;
+    }
+    for (size_t row = 0; row < count; row++) {
+        ids[row] = strtoul(csv_field(&data->containers, CONTAINER_COLUMNS_COUNT, row, CONTAINER_ID), NULL, 10);
+    }
+    qsort(ids, count, sizeof(unsigned long), compare_ids);
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < data->paths.count; i++) {
+        for (size_t column = PATH_A; ok && column <= PATH_B; column++) {
+            unsigned long id = strtoul(csv_field(&data->paths, PATH_COLUMNS_COUNT, i, column), NULL, 10);
+            if (bsearch(&id, ids, count, sizeof(unsigned long), compare_ids) == NULL) {
+                fprintf(stderr, "Unknown container %s on line %zu of %s.\n",
+                        csv_field(&data->paths, PATH_COLUMNS_COUNT, i, column), i + 1, paths_path);
+                ok = false;
+            }
+        }
+    }
+    free(ids);
+    return ok;
+}
+
+static int compare_capacity_entries(const void *a, const void *b) {
+    const CapacityEntry *first = a;
+    const CapacityEntry *second = b;
+    if (first->capacity != second->capacity) {
+        return first->capacity < second->capacity ? -1 : 1;
+    }
+    return (first->row > second->row) - (first->row < second->row);
+}
+
+size_t capacity_lower_bound(int capacity) {
+    size_t low = 0;
+    size_t high = current()->containers.count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (current()->capacity_index[middle].capacity < capacity) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+static void free_indexes(struct dataset *data) {
+    free(data->capacity_index);
+    data->capacity_index = NULL;
+    for (int type = 0; type < WASTE_TYPES_COUNT; type++) {
+        free(data->type_bitmaps[type]);
+        data->type_bitmaps[type] = NULL;
+    }
+    for (int flag = 0; flag < 2; flag++) {
+        free(data->public_bitmaps[flag]);
+        data->public_bitmaps[flag] = NULL;
+    }
+}
+
+static void free_columns(struct dataset *data) {
+    free(data->columns.type_bits);
+    free(data->columns.public_bits);
+    free(data->columns.capacity);
+}
+
+static bool build_columns(struct dataset *data) {
+    size_t count = data->containers.count;
+    ContainerColumns *columns = &data->columns;
+    columns->count = count;
+    columns->type_bits = malloc(count + 1);
+    columns->public_bits = malloc(count + 1);
+    columns->capacity = malloc((count + 1) * sizeof(int32_t));
+    if (columns->type_bits == NULL || columns->public_bits == NULL || columns->capacity == NULL) {
+        free_columns(data);
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        int type = waste_type_index(csv_field(&data->containers, CONTAINER_COLUMNS_COUNT, i, CONTAINER_WASTE_TYPE));
+        columns->type_bits[i] = type >= 0 ? (uint8_t) (1u << type) : OTHER_TYPE_BIT;
+        columns->public_bits[i] = strcmp(csv_field(&data->containers, CONTAINER_COLUMNS_COUNT, i, CONTAINER_PUBLIC), "Y") == 0
+                                  ? PUBLIC_BIT : NOT_PUBLIC_BIT;
+        columns->capacity[i] = atoi(csv_field(&data->containers, CONTAINER_COLUMNS_COUNT, i, CONTAINER_CAPACITY));
+        if (i == 0 || columns->capacity[i] < columns->capacity_lowest) {
+            columns->capacity_lowest = columns->capacity[i];
+        }
+        if (i == 0 || columns->capacity[i] > columns->capacity_highest) {
+            columns->capacity_highest = columns->capacity[i];
+        }
+    }
+    return true;
+}
+
+static bool build_indexes(struct dataset *data) {
+    if (data->capacity_index != NULL) {
+        return true;
+    }
+
+    const ContainerColumns *columns = &data->columns;
+    size_t count = columns->count;
+    bool ok = true;
+    for (int type = 0; type < WASTE_TYPES_COUNT; type++) {
+        ok &= (data->type_bitmaps[type] = create_bitmap(count)) != NULL;
+    }
+    ok &= (data->public_bitmaps[0] = create_bitmap(count)) != NULL;
+    ok &= (data->public_bitmaps[1] = create_bitmap(count)) != NULL;
+    // Zeroed, so the padding of the entries does not carry heap contents into a snapshot
+    ok &= (data->capacity_index = calloc(count + 1, sizeof(CapacityEntry))) != NULL;
+    if (!ok) {
+        free_indexes(data);
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        for (int type = 0; type < WASTE_TYPES_COUNT; type++) {
+            if (columns->type_bits[i] & (1u << type)) {
+                bitmap_set(data->type_bitmaps[type], i);
+            }
+        }
+        bitmap_set(data->public_bitmaps[columns->public_bits[i] == PUBLIC_BIT], i);
+        data->capacity_index[i].capacity = columns->capacity[i];
+        data->capacity_index[i].row = i;
+    }
+    qsort(data->capacity_index, count, sizeof(CapacityEntry), compare_capacity_entries);
+    return true;
+}
+
+bool build_container_indexes(void) {
+    return build_indexes(current());
+}
+
+static void free_version(struct dataset *data) {
+    if (data->snapshot != NULL) {
+        // The arrays are in the snapshot, only the graph itself was allocated
+        free(data->station_graph);
+        detach_snapshot(data->snapshot, data->snapshot_size);
+        free(data);
+        return;
+    }
+    destroy_station_graph(data->station_graph);
+    free_indexes(data);
+    free_columns(data);
+    free_csv_table(&data->containers);
+    free_csv_table(&data->paths);
+    free(data->paths_path);
+    free(data);
+}
+
+/* Reads the input files into a new version, see load_dataset(). Without
+ * holds_paths, the paths file is only remembered for the station graph,
+ * which otherwise reads the held paths, so both see the same file. */
+static struct dataset *load_version(const char *containers_path, const char *paths_path, bool holds_paths) {
+    struct dataset *data = calloc(1, sizeof(struct dataset));
+    if (data == NULL || (!holds_paths && paths_path != NULL && (data->paths_path = strdup(paths_path)) == NULL)) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        free(data);
+        return NULL;
+    }
+    if (!parse_input_files(containers_path, holds_paths ? paths_path : NULL, &data->containers, &data->paths)) {
+        free(data->paths_path);
+        free(data);
+        return NULL;
+    }
+
+    bool ok = validate_paths(data, paths_path);
+    if (ok && !build_columns(data)) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        ok = false;
+    }
+
+    if (!ok) {
+        free_csv_table(&data->containers);
+        free_csv_table(&data->paths);
+        free(data->paths_path);
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+bool load_dataset(const char *containers_path, const char *paths_path) {
+    published = load_version(containers_path, paths_path, paths_path != NULL);
+    return published != NULL;
+}
+
+// Builds the station graph of a version, pinned so that it reads the containers and paths of this version.
+static StationGraph *build_graph(struct dataset *data, bool *reported) {
+    struct dataset *previous_pin = pinned;
+    pinned = data;
+    StationGraph *graph = build_station_graph(data->paths_path, reported);
+    pinned = previous_pin;
+    return graph;
+}
+
+bool load_graph_dataset(const char *containers_path, const char *paths_path) {
+    struct dataset *data = load_version(containers_path, paths_path, false);
+    if (data == NULL) {
+        return false;
+    }
+    bool reported;
+    if ((data->station_graph = build_graph(data, &reported)) == NULL) {
+        if (!reported) {
+            fprintf(stderr, "Memory allocation failed.\n");
+        }
+        free_version(data);
+        return false;
+    }
+    published = data;
+    return true;
+}
+
+// Waits until no reader entered before the given epoch is still reading.
+static void wait_for_readers(uint64_t epoch) {
+    for (size_t reader = 0; reader < DATASET_READERS_MAX; reader++) {
+        for (;;) {
+            uint64_t entered = __atomic_load_n(&reader_epochs[reader].epoch, __ATOMIC_SEQ_CST);
+            if (entered == 0 || entered >= epoch) {
+                break;
+            }
+            usleep(1000);
+        }
+    }
+}
+
+// Builds the indexes and the station graph of a version no query reads yet.
+static bool complete_version(struct dataset *data) {
+    if (data->station_graph != NULL) {
+        return true;
+    }
+
+    bool reported = false;
+    bool ok = build_indexes(data) && (data->station_graph = build_graph(data, &reported)) != NULL;
+    if (!ok && !reported) {
+        fprintf(stderr, "Memory allocation failed.\n");
+    }
+    return ok;
+}
+
+// Publishes the complete version and frees the previous one once no reader holds it.
+static void replace_version(struct dataset *next) {
+    struct dataset *previous = __atomic_exchange_n(&published, next, __ATOMIC_SEQ_CST);
+    wait_for_readers(__atomic_add_fetch(&current_epoch, 1, __ATOMIC_SEQ_CST));
+    free_version(previous);
+}
+
+bool reload_dataset(const char *containers_path, const char *paths_path) {
+    struct dataset *next = load_version(containers_path, paths_path, paths_path != NULL);
+    if (next == NULL) {
+        return false;
+    }
+    if (!complete_version(next)) {
+        free_version(next);
+        return false;
+    }
+    replace_version(next);
+    return true;
+}
+
+/* Lays out all arrays of the data in the snapshot, the header first. The
+ * counts must be set before attaching; the arrays then point into the
+ * snapshot. */
+static void layout_snapshot(SnapshotLayout *layout, struct dataset *data, SnapshotHeader *header) {
+    SnapshotHeader *stored = snapshot_array(layout, header, sizeof(SnapshotHeader));
+    if (layout->mode == SNAPSHOT_ATTACH) {
+        if (stored == NULL) {
+            return;
+        }
+        *header = *stored;
+        if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0
+            || header->byte_order != SNAPSHOT_BYTE_ORDER || header->size != layout->size) {
+            layout->failed = true;
+            return;
+        }
+        data->containers = (CsvTable) { NULL, header->containers_strings_length, NULL, header->containers_count };
+        data->paths = (CsvTable) { NULL, header->paths_strings_length, NULL, header->paths_count };
+        data->columns.count = header->containers_count;
+        data->columns.capacity_lowest = header->capacity_lowest;
+        data->columns.capacity_highest = header->capacity_highest;
+        data->station_graph->stations_count = header->stations_count;
+        data->station_graph->containers_count = header->containers_count;
+    }
+
+    CsvTable *tables[] = { &data->containers, &data->paths };
+    size_t columns_counts[] = { CONTAINER_COLUMNS_COUNT, PATH_COLUMNS_COUNT };
+    for (size_t t = 0; t < 2; t++) {
+        tables[t]->strings = snapshot_array(layout, tables[t]->strings, tables[t]->strings_length);
+        tables[t]->fields = snapshot_array(layout, tables[t]->fields, tables[t]->count * columns_counts[t] * sizeof(size_t));
+    }
+
+    ContainerColumns *columns = &data->columns;
+    size_t count = columns->count;
+    columns->type_bits = snapshot_array(layout, columns->type_bits, count);
+    columns->public_bits = snapshot_array(layout, columns->public_bits, count);
+    columns->capacity = snapshot_array(layout, columns->capacity, count * sizeof(int32_t));
+
+    size_t bitmap_size = (bitmap_words(count) + 1) * sizeof(uint64_t);
+    for (int type = 0; type < WASTE_TYPES_COUNT; type++) {
+        data->type_bitmaps[type] = snapshot_array(layout, data->type_bitmaps[type], bitmap_size);
+    }
+    for (int flag = 0; flag < 2; flag++) {
+        data->public_bitmaps[flag] = snapshot_array(layout, data->public_bitmaps[flag], bitmap_size);
+    }
+    data->capacity_index = snapshot_array(layout, data->capacity_index, count * sizeof(CapacityEntry));
+
+    StationGraph *graph = data->station_graph;
+    size_t stations = graph->stations_count;
+    graph->x = snapshot_array(layout, graph->x, stations * sizeof(double));
+    graph->y = snapshot_array(layout, graph->y, stations * sizeof(double));
+    graph->waste_mask = snapshot_array(layout, graph->waste_mask, stations);
+    graph->capacity = snapshot_array(layout, graph->capacity, stations * WASTE_TYPES_COUNT * sizeof(unsigned long));
+    graph->station_of_row = snapshot_array(layout, graph->station_of_row, count * sizeof(size_t));
+    graph->container_offsets = snapshot_array(layout, graph->container_offsets, (stations + 2) * sizeof(size_t));
+    graph->container_rows = snapshot_array(layout, graph->container_rows, count * sizeof(size_t));
+    graph->adjacency_offsets = snapshot_array(layout, graph->adjacency_offsets, (stations + 2) * sizeof(size_t));
+    if (graph->adjacency_offsets == NULL) {
+        return;
+    }
+    size_t edges = graph->adjacency_offsets[stations];
+    graph->adjacency = snapshot_array(layout, graph->adjacency, edges * sizeof(size_t));
+    graph->weights = snapshot_array(layout, graph->weights, edges * sizeof(double));
+}
+
+bool publish_dataset(const char *target) {
+    struct dataset *data = current();
+    if (!complete_version(data)) {
+        return false;
+    }
+
+    SnapshotHeader header = {
+        "", SNAPSHOT_BYTE_ORDER, 0, data->containers.count, data->containers.strings_length, data->paths.count,
+        data->paths.strings_length, data->columns.capacity_lowest, data->columns.capacity_highest,
+        data->station_graph->stations_count
+    };
+    SnapshotLayout layout = { SNAPSHOT_MEASURE, NULL, 0, 0, false };
+    layout_snapshot(&layout, data, &header);
+    // Padding at the end keeps vector loads past the last array inside the mapping
+    header.size = layout.offset + SNAPSHOT_ALIGNMENT;
+
+    char *base = create_snapshot(target, header.size);
+    if (base == NULL) {
+        return false;
+    }
+    layout = (SnapshotLayout) { SNAPSHOT_WRITE, base, header.size, 0, false };
+    layout_snapshot(&layout, data, &header);
+    memcpy(((SnapshotHeader *) base)->magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    detach_snapshot(base, header.size);
+    return !layout.failed;
+}
+
+// Maps the snapshot as a new version of the data; NULL with a message on failure.
+static struct dataset *open_snapshot(const char *target) {
+    struct dataset *data = calloc(1, sizeof(struct dataset));
+    if (data == NULL || (data->station_graph = calloc(1, sizeof(StationGraph))) == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        free(data);
+        return NULL;
+    }
+    if ((data->snapshot = attach_snapshot(target, &data->snapshot_size)) == NULL) {
+        free(data->station_graph);
+        free(data);
+        return NULL;
+    }
+
+    SnapshotHeader header;
+    SnapshotLayout layout = { SNAPSHOT_ATTACH, data->snapshot, data->snapshot_size, 0, false };
+    layout_snapshot(&layout, data, &header);
+    if (layout.failed) {
+        fprintf(stderr, "Invalid snapshot %s.\n", target);
+        free_version(data);
+        return NULL;
+    }
+    return data;
+}
+
+bool attach_dataset(const char *target) {
+    published = open_snapshot(target);
+    return published != NULL;
+}
+
+bool reattach_dataset(const char *target) {
+    struct dataset *next = open_snapshot(target);
+    if (next == NULL) {
+        return false;
+    }
+    replace_version(next);
+    return true;
+}
+
+void enter_dataset(size_t reader) {
+    // The epoch is announced before the version is read, so a swap after the
+    // read waits for this reader, and a swap before it is seen by the read
+    __atomic_store_n(&reader_epochs[reader].epoch, __atomic_load_n(&current_epoch, __ATOMIC_SEQ_CST),
+                     __ATOMIC_SEQ_CST);
+    pinned = __atomic_load_n(&published, __ATOMIC_SEQ_CST);
+}
+
+void leave_dataset(size_t reader) {
+    pinned = NULL;
+    __atomic_store_n(&reader_epochs[reader].epoch, 0, __ATOMIC_RELEASE);
+}
+
+const StationGraph *get_station_graph(void) {
+    struct dataset *data = current();
+    StationGraph *graph = __atomic_load_n(&data->station_graph, __ATOMIC_ACQUIRE);
+    if (graph != NULL) {
+        return graph;
+    }
+
+    pthread_mutex_lock(&station_graph_lock);
+    if (data->station_graph == NULL) {
+        bool reported;
+        __atomic_store_n(&data->station_graph, build_graph(data, &reported), __ATOMIC_RELEASE);
+    }
+    graph = data->station_graph;
+    pthread_mutex_unlock(&station_graph_lock);
+    return graph;
+}
+
+void destroy_dataset(void) {
+    if (published == NULL) {
+        return;
+    }
+    free_version(published);
+    published = NULL;
+}
+
+size_t containers_count(void) {
+    return current()->containers.count;
+}
+
+size_t paths_count(void) {
+    return current()->paths.count;
+}
+
+const char *container_field(size_t row, int column) {
+    return csv_field(&current()->containers, CONTAINER_COLUMNS_COUNT, row, (size_t) column);
+}
+
+const char *path_field(size_t row, int column) {
+    return csv_field(&current()->paths, PATH_COLUMNS_COUNT, row, (size_t) column);
+}
+
+const ContainerColumns *container_columns(void) {
+    return &current()->columns;
+}
+
+bool container_indexes_built(void) {
+    return current()->capacity_index != NULL;
+}
+
+const uint64_t *type_bitmap(int type) {
+    return current()->type_bitmaps[type];
+}
+
+const uint64_t *public_bitmap(int flag) {
+    return current()->public_bitmaps[flag];
+}
+
+size_t row_by_capacity(size_t position) {
+    return current()->capacity_index[position].row;
+}
+
+EdgeFile *neighbor_edges(void) {
+    return current()->neighbor_edges;
+}
+
+Dataset *create_batch_dataset(CsvTable *containers) {
+    struct dataset *batch = calloc(1, sizeof(struct dataset));
+    if (batch == NULL) {
+        free_csv_table(containers);
+        return NULL;
+    }
+    batch->containers = *containers;
+    if (!build_columns(batch)) {
+        free_csv_table(&batch->containers);
+        free(batch);
+        return NULL;
+    }
+    return batch;
+}
+
+void set_neighbor_edges(Dataset *batch, EdgeFile *edges) {
+    batch->neighbor_edges = edges;
+}
+
+void pin_batch_dataset(Dataset *batch) {
+    pinned = batch;
+}
+
+void free_batch_dataset(Dataset *batch) {
+    free_columns(batch);
+    free_csv_table(&batch->containers);
+    free(batch);
+}
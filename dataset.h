@@ -0,0 +1,190 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "csv.h"
+#include "edge_sort.h"
+#include "filter.h"
+#include "stations.h"
+
+/*
+ * The containers and paths the commands work on, with the columns, indexes
+ * and station graph derived from them.
+ *
+ * Queries read the published version; a reload builds the next one aside
+ * and swaps the pointer, and a thread can pin a version of its own, see
+ * enter_dataset(). A version can also be published as a snapshot other
+ * processes map.
+ *
+ * The input files are parsed by csv.h straight into the tables of each
+ * version. data_source.h is not used, as its single static copy of the
+ * files would have to be copied into every version.
+ */
+
+typedef struct dataset Dataset;
+
+/**
+ * @brief Reads the input files and publishes them as the current version,
+ * checking that every path connects two of the containers.
+ *
+ * @param paths_path NULL to skip loading the paths; the version then has none.
+ * @retval false if a file cannot be read or is invalid, with a message
+ * except for an invalid paths file, or on memory failure.
+ */
+bool load_dataset(const char *containers_path, const char *paths_path);
+
+/**
+ * @brief Reads the containers file and publishes it as the current version
+ * with its station graph, streaming the paths file into the graph instead
+ * of loading it.
+ *
+ * The edges of the paths are sorted within the budget of
+ * configure_edge_sort(), spilling to temporary files, so memory use does
+ * not grow with the paths file beyond the graph itself. The version holds
+ * no paths, only its station graph connects the containers.
+ *
+ * @retval false if a file cannot be read or is invalid, with a message
+ * except for an invalid paths file, or on memory failure.
+ */
+bool load_graph_dataset(const char *containers_path, const char *paths_path);
+
+/**
+ * @brief Publishes a snapshot published by publish_dataset() as the current
+ * version, mapped read-only instead of reading the input files.
+ *
+ * All processes attached to one snapshot share its memory. The indexes and
+ * the station graph are part of the snapshot.
+ *
+ * @param target "shm:NAME" for a POSIX shared memory object, otherwise a file.
+ * @retval false if the snapshot cannot be mapped or is not valid.
+ */
+bool attach_dataset(const char *target);
+
+/**
+ * @brief Publishes the current version with its indexes and station graph
+ * as a snapshot for attach_dataset().
+ *
+ * The snapshot holds no pointers, only offsets from its start, so every
+ * process can map it at any address. Replacing a snapshot leaves the
+ * processes attached to the previous one unaffected.
+ *
+ * @retval false if the snapshot cannot be written or on memory failure.
+ */
+bool publish_dataset(const char *target);
+
+/**
+ * @brief Builds the indexes answering the listing filters without a pass
+ * over all containers: a bitmap per waste type and public flag and the
+ * containers sorted by capacity.
+ *
+ * Worth it only when the loaded data serves many queries; a single listing
+ * is faster with the one-pass filter used without the indexes. Calling it
+ * again has no effect.
+ *
+ * @retval false on memory failure, the listing then works without indexes.
+ */
+bool build_container_indexes(void);
+
+/**
+ * @brief Returns the stations of the loaded containers connected by the
+ * paths of the loaded paths file, built by the first call.
+ *
+ * The graph is owned by the version and freed with it. Safe to call from
+ * several threads.
+ *
+ * @retval NULL on memory failure; a later call tries again.
+ */
+const StationGraph *get_station_graph(void);
+
+// Readers of the data that can hold a version at once, see enter_dataset().
+#define DATASET_READERS_MAX 256
+
+/**
+ * @brief Loads the input files again and publishes them as the new version
+ * of the data, with the container indexes and the station graph built.
+ *
+ * The new version is built on the calling thread while the previous one
+ * keeps answering queries; the swap itself is a single atomic store. The
+ * previous version is freed once the readers that entered before the swap
+ * have left, so the call waits for their queries to finish.
+ *
+ * @warning The calling thread must not be inside enter_dataset().
+ * @retval false if the files cannot be loaded; the previous version stays.
+ */
+bool reload_dataset(const char *containers_path, const char *paths_path);
+
+/**
+ * @brief Attaches the snapshot again and publishes it as the new version of
+ * the data, like reload_dataset() does with the input files.
+ *
+ * @retval false if the snapshot cannot be attached; the previous version stays.
+ */
+bool reattach_dataset(const char *target);
+
+/**
+ * @brief Pins the current version of the data for the queries of the
+ * calling thread until leave_dataset(), without taking a lock.
+ *
+ * Without it, a thread reads whatever version is published at the moment,
+ * which is enough while nothing reloads the data.
+ *
+ * @param reader slot of the reader, below DATASET_READERS_MAX and used
+ * by one thread at a time.
+ */
+void enter_dataset(size_t reader);
+
+// Releases the version pinned by enter_dataset() with the same reader slot.
+void leave_dataset(size_t reader);
+
+// Frees the current version; nothing is published afterwards.
+void destroy_dataset(void);
+
+// Counts of the containers and paths of the version read by the calling thread.
+size_t containers_count(void);
+size_t paths_count(void);
+
+// Returns a field of the container row, CONTAINER_ID and the following of csv.h.
+const char *container_field(size_t row, int column);
+
+// Returns a field of the path row, PATH_A and the following of csv.h.
+const char *path_field(size_t row, int column);
+
+// Filtered columns of the containers, extracted at load time.
+const ContainerColumns *container_columns(void);
+
+// Whether build_container_indexes() has built the indexes below.
+bool container_indexes_built(void);
+
+// Rows with the waste type of WASTE_TYPE_ORDER, or of the public flag, 0 for N and 1 for Y.
+const uint64_t *type_bitmap(int type);
+const uint64_t *public_bitmap(int flag);
+
+// Position of the first row of at least the given capacity among the rows sorted by capacity, then by row.
+size_t capacity_lower_bound(int capacity);
+
+// Row at the position among the rows sorted by capacity.
+size_t row_by_capacity(size_t position);
+
+// Edges between the IDs of the paths of a streamed batch, NULL for the paths of the version.
+EdgeFile *neighbor_edges(void);
+
+/**
+ * @brief Creates a version of its own for the rows of a batch of the
+ * streamed listing, taking over the table, and extracts its columns. It is
+ * never published; the thread working on the batch pins it.
+ *
+ * @retval NULL on memory failure, with the table freed.
+ */
+Dataset *create_batch_dataset(CsvTable *containers);
+
+// Makes the sorted edges the paths of the batch; they stay owned by the caller.
+void set_neighbor_edges(Dataset *batch, EdgeFile *edges);
+
+// Pins the batch for the queries of the calling thread, NULL to unpin it.
+void pin_batch_dataset(Dataset *batch);
+
+void free_batch_dataset(Dataset *batch);
+
+#endif // DATASET_H
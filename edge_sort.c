@@ -0,0 +1,551 @@
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "edge_sort.h"
+
+// Edges a run is first allocated for, grown up to the budget.
+#define EDGE_FIRST_CAPACITY 1024
+
+static struct {
+    size_t memory_budget;
+    const char *directory;
+} configuration = { EDGE_SORT_BUDGET, NULL };
+
+// Buffered sequential writer of a spill file.
+typedef struct {
+    int fd;
+    EdgeRecord *buffer;
+    size_t length;
+    size_t written;
+    bool failed;
+} EdgeOutput;
+
+// Buffered sequential reader of a spilled run.
+typedef struct {
+    int fd;
+    size_t next;                // Edge of the file read next
+    size_t remaining;           // Edges of the run not read yet
+    EdgeRecord *buffer;
+    size_t length;
+    size_t position;
+} EdgeInput;
+
+// Orders by from, then to, then distance, so the shortest edge of a pair comes first.
+static int compare_edges(const void *first, const void *second) {
+    const EdgeRecord *a = first;
+    const EdgeRecord *b = second;
+    if (a->from != b->from) {
+        return a->from < b->from ? -1 : 1;
+    }
+    if (a->to != b->to) {
+        return a->to < b->to ? -1 : 1;
+    }
+    if (a->distance != b->distance) {
+        return a->distance < b->distance ? -1 : 1;
+    }
+    return 0;
+}
+
+static bool same_pair(const EdgeRecord *a, const EdgeRecord *b) {
+    return a->from == b->from && a->to == b->to;
+}
+
+void configure_edge_sort(size_t memory_budget, const char *directory) {
+    configuration.memory_budget = memory_budget > 0 ? memory_budget : EDGE_SORT_BUDGET;
+    configuration.directory = directory;
+}
+
+// Creates an unnamed temporary file, removed once closed.
+static int open_spill_file(const char *directory) {
+    if (directory == NULL) {
+        directory = getenv("TMPDIR");
+    }
+    if (directory == NULL || directory[0] == '\0') {
+        directory = "/tmp";
+    }
+    size_t length = strlen(directory) + sizeof("/container-explorer-XXXXXX");
+    char *path = malloc(length);
+    if (path == NULL) {
+        return -1;
+    }
+    snprintf(path, length, "%s/container-explorer-XXXXXX", directory);
+    int fd = mkstemp(path);
+    if (fd >= 0) {
+        unlink(path);
+    }
+    free(path);
+    return fd;
+}
+
+static bool write_all(int fd, const void *data, size_t size) {
+    const char *position = data;
+    while (size > 0) {
+        ssize_t written = write(fd, position, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        position += written;
+        size -= (size_t) written;
+    }
+    return true;
+}
+
+// Reads the edges at the given edge of the file; false if they cannot be read whole.
+static bool read_edges(int fd, size_t first, EdgeRecord *edges, size_t count) {
+    size_t size = 0;
+    while (size < count * sizeof(EdgeRecord)) {
+        ssize_t got = pread(fd, (char *) edges + size, count * sizeof(EdgeRecord) - size,
+                            (off_t) (first * sizeof(EdgeRecord) + size));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        size += (size_t) got;
+    }
+    return true;
+}
+
+static bool open_output(EdgeOutput *output, const char *directory) {
+    output->buffer = malloc(EDGE_IO_RECORDS * sizeof(EdgeRecord));
+    output->fd = output->buffer != NULL ? open_spill_file(directory) : -1;
+    output->length = 0;
+    output->written = 0;
+    output->failed = output->fd < 0;
+    return !output->failed;
+}
+
+static void flush_output(EdgeOutput *output) {
+    if (!output->failed && !write_all(output->fd, output->buffer, output->length * sizeof(EdgeRecord))) {
+        output->failed = true;
+    }
+    output->length = 0;
+}
+
+static void put_edge(EdgeOutput *output, EdgeRecord edge) {
+    output->buffer[output->length++] = edge;
+    output->written++;
+    if (output->length == EDGE_IO_RECORDS) {
+        flush_output(output);
+    }
+}
+
+// Flushes the rest and frees the buffer, leaving the file open.
+static bool close_output(EdgeOutput *output) {
+    if (output->buffer != NULL) {
+        flush_output(output);
+    }
+    free(output->buffer);
+    output->buffer = NULL;
+    return !output->failed;
+}
+
+// Reads the next buffer of the run; false at its end or on failure.
+static bool refill_input(EdgeInput *input, bool *failed) {
+    size_t count = input->remaining < EDGE_IO_RECORDS ? input->remaining : EDGE_IO_RECORDS;
+    if (count > 0 && !read_edges(input->fd, input->next, input->buffer, count)) {
+        *failed = true;
+        return false;
+    }
+    input->next += count;
+    input->remaining -= count;
+    input->length = count;
+    input->position = 0;
+    return count > 0;
+}
+
+void init_edge_sorter(EdgeSorter *sorter) {
+    size_t budget = configuration.memory_budget;
+    size_t buffer_size = EDGE_IO_RECORDS * sizeof(EdgeRecord);
+
+    // Half of the budget collects a run, as sorting it may take as much again
+    sorter->capacity = budget / 2 / sizeof(EdgeRecord) > 0 ? budget / 2 / sizeof(EdgeRecord) : 1;
+    // A merge holds a buffer per run and one for its output
+    sorter->merge_ways = budget / buffer_size > 3 ? budget / buffer_size - 1 : 2;
+    if (sorter->merge_ways > EDGE_MERGE_WAYS) {
+        sorter->merge_ways = EDGE_MERGE_WAYS;
+    }
+    sorter->directory = configuration.directory;
+    sorter->records = NULL;
+    sorter->count = 0;
+    sorter->allocated = 0;
+    sorter->spill = -1;
+    sorter->run_ends = NULL;
+    sorter->runs_count = 0;
+    sorter->runs_capacity = 0;
+    sorter->failed = false;
+}
+
+// Sorts the collected edges, keeping the shortest edge of each pair.
+static void sort_run(EdgeSorter *sorter) {
+    if (sorter->count == 0) {
+        return;
+    }
+    qsort(sorter->records, sorter->count, sizeof(EdgeRecord), compare_edges);
+    size_t unique = 0;
+    for (size_t i = 0; i < sorter->count; i++) {
+        if (unique == 0 || !same_pair(&sorter->records[unique - 1], &sorter->records[i])) {
+            sorter->records[unique++] = sorter->records[i];
+        }
+    }
+    sorter->count = unique;
+}
+
+// Sorts the collected edges and appends them to the spill file as a run.
+static bool spill_run(EdgeSorter *sorter) {
+    if (sorter->spill < 0 && (sorter->spill = open_spill_file(sorter->directory)) < 0) {
+        return false;
+    }
+    if (sorter->runs_count == sorter->runs_capacity) {
+        size_t capacity = sorter->runs_capacity > 0 ? sorter->runs_capacity * 2 : 16;
+        size_t *run_ends = realloc(sorter->run_ends, capacity * sizeof(size_t));
+        if (run_ends == NULL) {
+            return false;
+        }
+        sorter->run_ends = run_ends;
+        sorter->runs_capacity = capacity;
+    }
+
+    sort_run(sorter);
+    if (!write_all(sorter->spill, sorter->records, sorter->count * sizeof(EdgeRecord))) {
+        return false;
+    }
+    size_t start = sorter->runs_count > 0 ? sorter->run_ends[sorter->runs_count - 1] : 0;
+    sorter->run_ends[sorter->runs_count++] = start + sorter->count;
+    sorter->count = 0;
+    return true;
+}
+
+bool add_edge(EdgeSorter *sorter, EdgeRecord edge) {
+    if (sorter->failed) {
+        return false;
+    }
+    if (sorter->count == sorter->allocated && sorter->allocated < sorter->capacity) {
+        size_t allocated = sorter->allocated > 0 ? sorter->allocated * 2 : EDGE_FIRST_CAPACITY;
+        allocated = allocated < sorter->capacity ? allocated : sorter->capacity;
+        EdgeRecord *records = realloc(sorter->records, allocated * sizeof(EdgeRecord));
+        if (records == NULL) {
+            sorter->failed = true;
+            return false;
+        }
+        sorter->records = records;
+        sorter->allocated = allocated;
+    }
+    if (sorter->count == sorter->capacity && !spill_run(sorter)) {
+        sorter->failed = true;
+        return false;
+    }
+    sorter->records[sorter->count++] = edge;
+    return true;
+}
+
+// Restores the heap of inputs ordered by their current edge, starting at the given slot.
+static void sift_down(EdgeInput **heap, size_t count, size_t slot) {
+    while (true) {
+        size_t smallest = slot;
+        for (size_t child = 2 * slot + 1; child <= 2 * slot + 2 && child < count; child++) {
+            if (compare_edges(&heap[child]->buffer[heap[child]->position],
+                              &heap[smallest]->buffer[heap[smallest]->position]) < 0) {
+                smallest = child;
+            }
+        }
+        if (smallest == slot) {
+            return;
+        }
+        EdgeInput *swapped = heap[slot];
+        heap[slot] = heap[smallest];
+        heap[smallest] = swapped;
+        slot = smallest;
+    }
+}
+
+// Records the from of every stride-th edge of the sorted edges, counted so far by written.
+static void index_edge(EdgeFile *sorted, size_t written, EdgeRecord edge) {
+    if (sorted != NULL && written % sorted->stride == 0) {
+        sorted->block_keys[written / sorted->stride] = edge.from;
+    }
+}
+
+/* Merges the given runs of the file into one run of the output, keeping
+ * the shortest edge of each pair, and indexes the output into the sorted
+ * file if given. */
+static bool merge_runs(int fd, const size_t *run_ends, size_t first, size_t count, EdgeOutput *output,
+                       EdgeFile *sorted) {
+    EdgeInput *inputs = calloc(count, sizeof(EdgeInput));
+    EdgeInput **heap = malloc(count * sizeof(EdgeInput *));
+    bool failed = count > 0 && (inputs == NULL || heap == NULL);
+    size_t heap_count = 0;
+    for (size_t i = 0; i < count && !failed; i++) {
+        size_t start = first + i > 0 ? run_ends[first + i - 1] : 0;
+        inputs[i] = (EdgeInput) { fd, start, run_ends[first + i] - start, NULL, 0, 0 };
+        inputs[i].buffer = malloc(EDGE_IO_RECORDS * sizeof(EdgeRecord));
+        if (inputs[i].buffer == NULL) {
+            failed = true;
+        } else if (refill_input(&inputs[i], &failed)) {
+            heap[heap_count++] = &inputs[i];
+        }
+    }
+    for (size_t i = heap_count; i-- > 0;) {
+        sift_down(heap, heap_count, i);
+    }
+
+    EdgeRecord last = { 0, 0, 0 };
+    bool any = false;
+    while (heap_count > 0 && !failed) {
+        EdgeInput *input = heap[0];
+        EdgeRecord edge = input->buffer[input->position++];
+        if (!any || !same_pair(&last, &edge)) {
+            index_edge(sorted, output->written, edge);
+            put_edge(output, edge);
+            last = edge;
+            any = true;
+        }
+        if (input->position == input->length && !refill_input(input, &failed)) {
+            heap[0] = heap[--heap_count];
+        }
+        sift_down(heap, heap_count, 0);
+    }
+
+    for (size_t i = 0; inputs != NULL && i < count; i++) {
+        free(inputs[i].buffer);
+    }
+    free(inputs);
+    free(heap);
+    return !failed;
+}
+
+// Merges groups of runs into a new spill file, which replaces the old one.
+static bool merge_pass(EdgeSorter *sorter) {
+    EdgeOutput output;
+    bool ok = open_output(&output, sorter->directory);
+    size_t merged = 0;
+    for (size_t first = 0; ok && first < sorter->runs_count; first += sorter->merge_ways) {
+        size_t rest = sorter->runs_count - first;
+        ok = merge_runs(sorter->spill, sorter->run_ends, first, rest < sorter->merge_ways ? rest : sorter->merge_ways,
+                        &output, NULL);
+        // The groups ahead read only ends past this one
+        sorter->run_ends[merged++] = output.written;
+    }
+    ok = close_output(&output) && ok;
+    if (!ok) {
+        if (output.fd >= 0) {
+            close(output.fd);
+        }
+        return false;
+    }
+    close(sorter->spill);
+    sorter->spill = output.fd;
+    sorter->runs_count = merged;
+    return true;
+}
+
+// Keeps the edges that fit into the budget in memory, sorted, instead of spilling them.
+static bool keep_in_memory(EdgeSorter *sorter, EdgeFile *sorted) {
+    sort_run(sorter);
+    sorted->blocks_count = (sorter->count + sorted->stride - 1) / sorted->stride;
+    sorted->block_keys = malloc((sorted->blocks_count + 1) * sizeof(uint32_t));
+    if (sorted->block_keys == NULL) {
+        sorted->blocks_count = 0;
+        return false;
+    }
+    for (size_t i = 0; i < sorter->count; i++) {
+        index_edge(sorted, i, sorter->records[i]);
+    }
+    sorted->records = sorter->records;
+    sorted->count = sorter->count;
+    sorter->records = NULL;
+    return true;
+}
+
+// Merges the spilled runs into the sorted file, in several passes if they are too many for one.
+static bool merge_spilled(EdgeSorter *sorter, EdgeFile *sorted) {
+    bool ok = sorter->count == 0 || spill_run(sorter);
+    free(sorter->records);
+    sorter->records = NULL;
+    while (ok && sorter->runs_count > sorter->merge_ways) {
+        ok = merge_pass(sorter);
+    }
+
+    // Every edge adds at most one key, so the runs bound the size of the index
+    size_t total = sorter->runs_count > 0 ? sorter->run_ends[sorter->runs_count - 1] : 0;
+    EdgeOutput output = { -1, NULL, 0, 0, true };
+    if (ok) {
+        sorted->block_keys = malloc((total / sorted->stride + 1) * sizeof(uint32_t));
+        sorted->cached = malloc(sorted->stride * sizeof(EdgeRecord));
+        ok = sorted->block_keys != NULL && sorted->cached != NULL && open_output(&output, sorter->directory);
+    }
+    ok = ok && merge_runs(sorter->spill, sorter->run_ends, 0, sorter->runs_count, &output, sorted);
+    ok = close_output(&output) && ok;
+    if (!ok) {
+        if (output.fd >= 0) {
+            close(output.fd);
+        }
+        return false;
+    }
+    sorted->fd = output.fd;
+    sorted->count = output.written;
+    sorted->blocks_count = (output.written + sorted->stride - 1) / sorted->stride;
+    return true;
+}
+
+bool finish_edge_sort(EdgeSorter *sorter, EdgeFile *sorted) {
+    *sorted = (EdgeFile) { -1, NULL, 0, NULL, 0, EDGE_INDEX_STRIDE, NULL, SIZE_MAX, 0 };
+    // The cached block is within the budget like a run
+    if (sorted->stride > sorter->capacity) {
+        sorted->stride = sorter->capacity;
+    }
+    bool ok = !sorter->failed;
+    if (ok && sorter->runs_count == 0) {
+        ok = keep_in_memory(sorter, sorted);
+    } else if (ok) {
+        ok = merge_spilled(sorter, sorted);
+    }
+
+    if (sorter->spill >= 0) {
+        close(sorter->spill);
+    }
+    free(sorter->records);
+    free(sorter->run_ends);
+    sorter->records = NULL;
+    sorter->run_ends = NULL;
+    sorter->spill = -1;
+    sorter->count = 0;
+    sorter->runs_count = 0;
+    if (!ok) {
+        close_edge_file(sorted);
+        fprintf(stderr, "Sorting the paths in temporary files failed.\n");
+        return false;
+    }
+    return true;
+}
+
+// Returns the edges of the block, read into the cache unless they are in memory; NULL if they cannot be read.
+static const EdgeRecord *read_block(EdgeFile *file, size_t block, size_t *count) {
+    size_t first = block * file->stride;
+    *count = file->count - first < file->stride ? file->count - first : file->stride;
+    if (file->fd < 0) {
+        return file->records + first;
+    }
+    if (file->cached_block != block) {
+        file->cached_block = SIZE_MAX;
+        if (!read_edges(file->fd, first, file->cached, *count)) {
+            return NULL;
+        }
+        file->cached_block = block;
+    }
+    return file->cached;
+}
+
+bool find_edges(EdgeFile *file, uint32_t from, uint32_t **targets, size_t *count) {
+    *targets = NULL;
+    *count = 0;
+
+    // The edges start in the last block beginning before them, as the block beginning with them may follow it
+    size_t low = 0;
+    size_t high = file->blocks_count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (file->block_keys[middle] < from) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    size_t block = low > 0 ? low - 1 : 0;
+
+    size_t capacity = 0;
+    for (; block < file->blocks_count && file->block_keys[block] <= from; block++) {
+        size_t edges_count;
+        const EdgeRecord *edges = read_block(file, block, &edges_count);
+        if (edges == NULL) {
+            free(*targets);
+            *targets = NULL;
+            return false;
+        }
+
+        // The first edge of the block from the node, by a binary search
+        size_t i = 0;
+        size_t end = edges_count;
+        while (i < end) {
+            size_t middle = i + (end - i) / 2;
+            if (edges[middle].from < from) {
+                i = middle + 1;
+            } else {
+                end = middle;
+            }
+        }
+        for (; i < edges_count && edges[i].from == from; i++) {
+            if (*count == capacity) {
+                capacity = capacity > 0 ? capacity * 2 : 16;
+                uint32_t *grown = realloc(*targets, capacity * sizeof(uint32_t));
+                if (grown == NULL) {
+                    free(*targets);
+                    *targets = NULL;
+                    return false;
+                }
+                *targets = grown;
+            }
+            (*targets)[(*count)++] = edges[i].to;
+        }
+    }
+    return true;
+}
+
+void close_edge_file(EdgeFile *file) {
+    if (file->fd >= 0) {
+        close(file->fd);
+    }
+    free(file->records);
+    free(file->block_keys);
+    free(file->cached);
+    *file = (EdgeFile) { -1, NULL, 0, NULL, 0, EDGE_INDEX_STRIDE, NULL, SIZE_MAX, 0 };
+}
+
+bool open_edge_reader(EdgeReader *reader, const EdgeFile *file) {
+    *reader = (EdgeReader) { file, 0, NULL, 0, 0, false };
+    if (file->fd < 0) {
+        reader->length = file->count;
+        return true;
+    }
+    reader->buffer = malloc(EDGE_IO_RECORDS * sizeof(EdgeRecord));
+    return reader->buffer != NULL;
+}
+
+bool next_edge(EdgeReader *reader, EdgeRecord *edge) {
+    const EdgeFile *file = reader->file;
+    if (file->fd < 0) {
+        if (reader->position == reader->length) {
+            return false;
+        }
+        *edge = file->records[reader->position++];
+        return true;
+    }
+    if (reader->position == reader->length) {
+        size_t rest = file->count - reader->next;
+        size_t count = rest < EDGE_IO_RECORDS ? rest : EDGE_IO_RECORDS;
+        if (count == 0 || reader->failed) {
+            return false;
+        }
+        if (!read_edges(file->fd, reader->next, reader->buffer, count)) {
+            reader->failed = true;
+            return false;
+        }
+        reader->next += count;
+        reader->length = count;
+        reader->position = 0;
+    }
+    *edge = reader->buffer[reader->position++];
+    return true;
+}
+
+void close_edge_reader(EdgeReader *reader) {
+    free(reader->buffer);
+    reader->buffer = NULL;
+}
@@ -0,0 +1,134 @@
+#ifndef EDGE_SORT_H
+#define EDGE_SORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * External sort of the edges of the paths: edges are collected in runs of
+ * bounded size, each sorted in memory and spilled to a temporary file, and
+ * the runs are merged into one sorted file. Memory use is bounded by the
+ * budget, which holds the run being collected and the buffers of the runs
+ * merged at once, whatever the count of edges. Edges fitting the budget
+ * are not spilled at all.
+ *
+ * All runs are spilled to one file and each merge pass writes one more, so
+ * only a few files are open at a time. Temporary files are created in the
+ * configured directory, $TMPDIR or /tmp, and unlinked at once.
+ */
+
+// Bytes of memory a sort uses unless configured otherwise.
+#define EDGE_SORT_BUDGET (16 * 1024 * 1024)
+
+// Runs merged at once at most; more runs are merged in several passes.
+#define EDGE_MERGE_WAYS 64
+
+// Edges read or written by one call on a spill file.
+#define EDGE_IO_RECORDS 8192
+
+// Edges of the sorted file per entry of its sparse index, fewer if a run of the budget holds fewer.
+#define EDGE_INDEX_STRIDE 512
+
+typedef struct {
+    uint32_t from;
+    uint32_t to;
+    uint32_t distance;
+} EdgeRecord;
+
+typedef struct {
+    EdgeRecord *records;        // The run being collected
+    size_t count;
+    size_t allocated;
+    size_t capacity;            // Edges of a run at most
+    size_t merge_ways;          // Runs whose buffers fit into the budget
+    const char *directory;      // Of the temporary files
+    int spill;                  // File of the spilled runs one after another, -1 before the first
+    size_t *run_ends;           // Edges of the file up to the end of each run
+    size_t runs_count;
+    size_t runs_capacity;
+    bool failed;
+} EdgeSorter;
+
+/**
+ * @brief The sorted edges, ordered by from and then to, with one edge of
+ * the shortest distance for each pair, and a sparse index kept in memory.
+ * In a temporary file, or in memory if they fit into the budget.
+ */
+typedef struct {
+    int fd;                     // -1 if the edges are in memory
+    EdgeRecord *records;        // The edges if in memory
+    size_t count;
+    uint32_t *block_keys;       // from of every stride-th edge
+    size_t blocks_count;
+    size_t stride;
+    // The block read last, as lookups of close IDs read the same blocks
+    EdgeRecord *cached;
+    size_t cached_block;
+    size_t cached_count;
+} EdgeFile;
+
+// Sequential reader of the sorted edges.
+typedef struct {
+    const EdgeFile *file;
+    size_t next;                // Edge read next
+    EdgeRecord *buffer;         // Of a file, NULL for edges in memory
+    size_t length;
+    size_t position;
+    bool failed;
+} EdgeReader;
+
+/**
+ * @brief Sets the memory budget and the directory of the temporary files
+ * of the sorts started later.
+ *
+ * @param memory_budget bytes, 0 for EDGE_SORT_BUDGET. A budget of a few
+ * edges spills them in runs of that many, merged two at a time.
+ * @param directory NULL for $TMPDIR, or /tmp if it is not set. Not copied.
+ */
+void configure_edge_sort(size_t memory_budget, const char *directory);
+
+// Prepares an empty sorter with the configured budget, allocating as the edges come.
+void init_edge_sorter(EdgeSorter *sorter);
+
+/**
+ * @brief Adds an edge, spilling the collected run once it fills the budget.
+ *
+ * @retval false if memory or a temporary file failed; the sorter stays
+ * failed and finish_edge_sort() reports it again.
+ */
+bool add_edge(EdgeSorter *sorter, EdgeRecord edge);
+
+/**
+ * @brief Merges all edges into the sorted file and frees the sorter.
+ *
+ * @retval false if memory or a temporary file failed, with a message.
+ */
+bool finish_edge_sort(EdgeSorter *sorter, EdgeFile *sorted);
+
+/**
+ * @brief Finds the targets of all edges from the given node, in ascending
+ * order, reading only the blocks of the file that hold them. Called by one
+ * thread at a time, as the last block read is kept.
+ *
+ * @param targets receives an array to be released by free(), NULL if empty.
+ * @retval false if reading the file or memory failed.
+ */
+bool find_edges(EdgeFile *file, uint32_t from, uint32_t **targets, size_t *count);
+
+// Closes the file and frees its index.
+void close_edge_file(EdgeFile *file);
+
+// Starts reading the sorted edges from the first; false on memory failure.
+bool open_edge_reader(EdgeReader *reader, const EdgeFile *file);
+
+/**
+ * @brief Reads the next edge in order.
+ *
+ * @retval false after the last edge, or if reading failed, which sets failed.
+ */
+bool next_edge(EdgeReader *reader, EdgeRecord *edge);
+
+void close_edge_reader(EdgeReader *reader);
+
+#endif // EDGE_SORT_H
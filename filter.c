@@ -0,0 +1,281 @@
+#include "filter.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define FILTER_X86_SIMD 1
+#endif
+
+typedef size_t (*FilterFunction)(const ContainerColumns *columns, const RowFilter *filter, size_t begin,
+                                 size_t *rows);
+
+// Filters the rows from begin to the end; the SIMD variants finish their tails here.
+static size_t filter_scalar(const ContainerColumns *columns, const RowFilter *filter, size_t begin,
+                            size_t *rows) {
+    size_t count = 0;
+    for (size_t i = begin; i < columns->count; i++) {
+        // Branch-free: the row is always written, but only kept when accepted
+        rows[count] = i;
+        count += ((columns->type_bits[i] & filter->type_mask) != 0)
+                 & ((columns->public_bits[i] & filter->public_mask) != 0)
+                 & (columns->capacity[i] >= filter->capacity_min)
+                 & (columns->capacity[i] <= filter->capacity_max);
+    }
+    return count;
+}
+
+#ifdef FILTER_X86_SIMD
+/* Lane permutations moving the accepted lanes to the front: entry m of
+ * compact_lanes lists the positions of the set bits of m, compact_bytes does
+ * the same for four 32-bit lanes as a byte shuffle. Filled on first use. */
+static int32_t compact_lanes[256][8];
+static uint8_t compact_bytes[16][16];
+static pthread_once_t compact_once = PTHREAD_ONCE_INIT;
+
+static void fill_compact_tables(void) {
+    for (unsigned mask = 0; mask < 256; mask++) {
+        int count = 0;
+        for (int lane = 0; lane < 8; lane++) {
+            if (mask & (1u << lane)) {
+                if (mask < 16) {
+                    for (int byte = 0; byte < 4; byte++) {
+                        compact_bytes[mask][count * 4 + byte] = (uint8_t) (lane * 4 + byte);
+                    }
+                }
+                compact_lanes[mask][count++] = lane;
+            }
+        }
+    }
+}
+
+// Stores the four row indices base + lane, accepted lanes first, and returns how many were accepted.
+__attribute__((target("sse4.1")))
+static size_t store_rows_sse41(unsigned accepted, __m128i lanes, size_t base, size_t *rows) {
+    __m128i indices = _mm_add_epi32(_mm_shuffle_epi8(lanes, _mm_loadu_si128((const __m128i *) compact_bytes[accepted])),
+                                    _mm_set1_epi32((int32_t) base));
+    _mm_storeu_si128((__m128i *) rows, _mm_cvtepu32_epi64(indices));
+    _mm_storeu_si128((__m128i *) (rows + 2), _mm_cvtepu32_epi64(_mm_unpackhi_epi64(indices, indices)));
+    return (size_t) __builtin_popcount(accepted);
+}
+
+// The filter broadcast to all lanes.
+typedef struct {
+    __m256i type_mask;
+    __m256i public_mask;
+    __m256i capacity_min;
+    __m256i capacity_max;
+} FilterLanes;
+
+__attribute__((target("avx2")))
+static inline FilterLanes filter_lanes_avx2(const RowFilter *filter) {
+    FilterLanes lanes = {
+        _mm256_set1_epi32(filter->type_mask),
+        _mm256_set1_epi32(filter->public_mask),
+        _mm256_set1_epi32(filter->capacity_min),
+        _mm256_set1_epi32(filter->capacity_max),
+    };
+    return lanes;
+}
+
+// Widens the type bits of eight rows starting at row i to 32-bit lanes.
+__attribute__((target("avx2")))
+static inline __m256i type_lanes_avx2(const ContainerColumns *columns, size_t i) {
+    int64_t types;
+    memcpy(&types, columns->type_bits + i, sizeof(types));
+    return _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(types));
+}
+
+// Rejection lane mask of eight rows starting at row i.
+__attribute__((target("avx2")))
+static inline __m256i reject_avx2(const ContainerColumns *columns, size_t i, __m256i type_lanes,
+                                  const FilterLanes *filter) {
+    int64_t public;
+    memcpy(&public, columns->public_bits + i, sizeof(public));
+    __m256i public_lanes = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(public));
+    __m256i capacity = _mm256_loadu_si256((const __m256i *) (columns->capacity + i));
+    __m256i zero = _mm256_setzero_si256();
+
+    return _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi32(_mm256_and_si256(type_lanes, filter->type_mask), zero),
+                        _mm256_cmpeq_epi32(_mm256_and_si256(public_lanes, filter->public_mask), zero)),
+        _mm256_or_si256(_mm256_cmpgt_epi32(capacity, filter->capacity_max),
+                        _mm256_cmpgt_epi32(filter->capacity_min, capacity)));
+}
+
+/* Eight rows per step: the byte columns are widened to 32-bit lanes to line
+ * up with the capacities, every condition becomes a lane mask and the
+ * combined mask is turned into row indices. */
+__attribute__((target("avx2")))
+static size_t filter_avx2(const ContainerColumns *columns, const RowFilter *filter, size_t begin, size_t *rows) {
+    const FilterLanes lanes_filter = filter_lanes_avx2(filter);
+    const __m256i offsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i base = _mm256_set1_epi64x((int64_t) begin);
+    pthread_once(&compact_once, fill_compact_tables);
+
+    size_t count = 0;
+    size_t i = begin;
+    for (; i + 8 <= columns->count; i += 8) {
+        __m256i rejected = reject_avx2(columns, i, type_lanes_avx2(columns, i), &lanes_filter);
+        unsigned accepted = ~(unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(rejected)) & 0xffu;
+
+        // All eight row indices are stored, the accepted ones first; count <= i leaves room for them
+        __m256i lanes = _mm256_loadu_si256((const __m256i *) compact_lanes[accepted]);
+        __m256i indices = _mm256_add_epi32(_mm256_permutevar8x32_epi32(offsets, lanes),
+                                           _mm256_set1_epi32((int32_t) (i - begin)));
+        _mm256_storeu_si256((__m256i *) (rows + count),
+                            _mm256_add_epi64(base, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(indices))));
+        _mm256_storeu_si256((__m256i *) (rows + count + 4),
+                            _mm256_add_epi64(base, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(indices, 1))));
+        count += (size_t) __builtin_popcount(accepted);
+    }
+    return count + filter_scalar(columns, filter, i, rows + count);
+}
+
+/* Keeps per type a count and a capacity sum in every lane: a row adds its
+ * capacity to the lanes of its type only if accepted, otherwise zero. The
+ * lanes are 32 bits wide and moved to the 64-bit totals before they could
+ * overflow, which the range of the capacities tells. Only the types the
+ * filter accepts get lanes. */
+__attribute__((target("avx2")))
+static size_t sum_by_type_avx2(const ContainerColumns *columns, const RowFilter *filter, GroupTotals *totals) {
+    const FilterLanes lanes_filter = filter_lanes_avx2(filter);
+    int64_t lowest = columns->capacity_lowest > filter->capacity_min ? columns->capacity_lowest : filter->capacity_min;
+    int64_t highest = columns->capacity_highest < filter->capacity_max ? columns->capacity_highest
+                                                                         : filter->capacity_max;
+    int64_t bound = llabs(lowest) > llabs(highest) ? llabs(lowest) : llabs(highest);
+    size_t flush_rows = 8 * (size_t) (INT32_MAX / (bound > 0 ? bound : 1));
+
+    int types[TYPE_BITS_COUNT];
+    int types_count = 0;
+    for (int type = 0; type < TYPE_BITS_COUNT; type++) {
+        if (filter->type_mask & (1u << type)) {
+            types[types_count++] = type;
+        }
+    }
+
+    size_t i = 0;
+    while (i + 8 <= columns->count) {
+        __m256i counts[TYPE_BITS_COUNT];
+        __m256i sums[TYPE_BITS_COUNT];
+        for (int t = 0; t < types_count; t++) {
+            counts[t] = sums[t] = _mm256_setzero_si256();
+        }
+
+        size_t end = columns->count - i > flush_rows ? i + flush_rows : columns->count;
+        for (; i + 8 <= end; i += 8) {
+            __m256i type_lanes = type_lanes_avx2(columns, i);
+            __m256i rejected = reject_avx2(columns, i, type_lanes, &lanes_filter);
+            __m256i capacity = _mm256_loadu_si256((const __m256i *) (columns->capacity + i));
+            for (int t = 0; t < types_count; t++) {
+                __m256i selected = _mm256_andnot_si256(rejected,
+                                                       _mm256_cmpeq_epi32(type_lanes, _mm256_set1_epi32(1 << types[t])));
+                counts[t] = _mm256_sub_epi32(counts[t], selected);
+                sums[t] = _mm256_add_epi32(sums[t], _mm256_and_si256(capacity, selected));
+            }
+        }
+
+        for (int t = 0; t < types_count; t++) {
+            int32_t count_lanes[8];
+            int32_t sum_lanes[8];
+            _mm256_storeu_si256((__m256i *) count_lanes, counts[t]);
+            _mm256_storeu_si256((__m256i *) sum_lanes, sums[t]);
+            for (int lane = 0; lane < 8; lane++) {
+                totals[types[t]].count += (uint64_t) count_lanes[lane];
+                totals[types[t]].capacity += sum_lanes[lane];
+            }
+        }
+    }
+    return i;
+}
+
+// Rejection lane mask of four rows starting at row i.
+__attribute__((target("sse4.1")))
+static inline __m128i reject_sse41(const ContainerColumns *columns, size_t i, __m128i type_mask, __m128i public_mask,
+                                   __m128i capacity_min, __m128i capacity_max) {
+    int32_t types;
+    int32_t public;
+    memcpy(&types, columns->type_bits + i, sizeof(types));
+    memcpy(&public, columns->public_bits + i, sizeof(public));
+    __m128i type_lanes = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(types));
+    __m128i public_lanes = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(public));
+    __m128i capacity = _mm_loadu_si128((const __m128i *) (columns->capacity + i));
+    __m128i zero = _mm_setzero_si128();
+
+    return _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi32(_mm_and_si128(type_lanes, type_mask), zero),
+                     _mm_cmpeq_epi32(_mm_and_si128(public_lanes, public_mask), zero)),
+        _mm_or_si128(_mm_cmpgt_epi32(capacity, capacity_max), _mm_cmpgt_epi32(capacity_min, capacity)));
+}
+
+// The same as filter_avx2() on 128-bit vectors, two of them per step.
+__attribute__((target("sse4.1")))
+static size_t filter_sse41(const ContainerColumns *columns, const RowFilter *filter, size_t begin, size_t *rows) {
+    const __m128i type_mask = _mm_set1_epi32(filter->type_mask);
+    const __m128i public_mask = _mm_set1_epi32(filter->public_mask);
+    const __m128i capacity_min = _mm_set1_epi32(filter->capacity_min);
+    const __m128i capacity_max = _mm_set1_epi32(filter->capacity_max);
+    const __m128i offsets = _mm_setr_epi32(0, 1, 2, 3);
+    pthread_once(&compact_once, fill_compact_tables);
+
+    size_t count = 0;
+    size_t i = begin;
+    for (; i + 8 <= columns->count; i += 8) {
+        __m128i low = reject_sse41(columns, i, type_mask, public_mask, capacity_min, capacity_max);
+        __m128i high = reject_sse41(columns, i + 4, type_mask, public_mask, capacity_min, capacity_max);
+        unsigned accepted = ~(unsigned) _mm_movemask_epi8(_mm_packs_epi16(_mm_packs_epi32(low, high), _mm_setzero_si128()))
+                            & 0xffu;
+        count += store_rows_sse41(accepted & 0xfu, offsets, i, rows + count);
+        count += store_rows_sse41(accepted >> 4, offsets, i + 4, rows + count);
+    }
+    return count + filter_scalar(columns, filter, i, rows + count);
+}
+#endif
+
+static FilterFunction select_filter(void) {
+#ifdef FILTER_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        return filter_avx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return filter_sse41;
+    }
+#endif
+    return filter_scalar;
+}
+
+size_t filter_rows(const ContainerColumns *columns, const RowFilter *filter, size_t *rows) {
+    return select_filter()(columns, filter, 0, rows);
+}
+
+void sum_by_type(const ContainerColumns *columns, const RowFilter *filter, GroupTotals *totals) {
+    memset(totals, 0, TYPE_BITS_COUNT * sizeof(GroupTotals));
+    size_t i = 0;
+#ifdef FILTER_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        i = sum_by_type_avx2(columns, filter, totals);
+    }
+#endif
+    for (; i < columns->count; i++) {
+        bool accepted = (columns->type_bits[i] & filter->type_mask) != 0
+                        && (columns->public_bits[i] & filter->public_mask) != 0
+                        && columns->capacity[i] >= filter->capacity_min && columns->capacity[i] <= filter->capacity_max;
+        if (accepted) {
+            GroupTotals *group = &totals[__builtin_ctz(columns->type_bits[i])];
+            group->count++;
+            group->capacity += columns->capacity[i];
+        }
+    }
+}
+
+void sum_rows_by_group(const ContainerColumns *columns, const size_t *rows, size_t count, const size_t *group_of_row,
+                       GroupTotals *totals) {
+    for (size_t k = 0; k < count; k++) {
+        GroupTotals *group = &totals[group_of_row[rows[k]]];
+        group->count++;
+        group->capacity += columns->capacity[rows[k]];
+    }
+}
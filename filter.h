@@ -0,0 +1,78 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bit of containers whose waste type is none of WASTE_TYPE_ORDER in ContainerColumns.type_bits.
+#define OTHER_TYPE_BIT (1u << 6)
+
+// Count of the bits used in ContainerColumns.type_bits: the waste types and OTHER_TYPE_BIT.
+#define TYPE_BITS_COUNT 7
+
+// Bits of ContainerColumns.public_bits.
+#define NOT_PUBLIC_BIT 1u
+#define PUBLIC_BIT 2u
+
+/**
+ * @brief The columns of the containers the listing filters look at, one
+ * element per row.
+ *
+ * Waste type and public flag are single bits, so that any set of accepted
+ * values is a mask and every filter is the same AND-and-compare.
+ */
+typedef struct {
+    size_t count;
+    uint8_t *type_bits;     // 1 << index in WASTE_TYPE_ORDER, or OTHER_TYPE_BIT
+    uint8_t *public_bits;   // NOT_PUBLIC_BIT or PUBLIC_BIT
+    int32_t *capacity;
+    int32_t capacity_lowest;    // Smallest and largest capacity of all rows
+    int32_t capacity_highest;
+} ContainerColumns;
+
+// Accepted rows: (type_bits & type_mask) && (public_bits & public_mask) && capacity in [min, max].
+typedef struct {
+    uint8_t type_mask;
+    uint8_t public_mask;
+    int32_t capacity_min;
+    int32_t capacity_max;
+} RowFilter;
+
+/**
+ * @brief Evaluates the filter over all rows in one pass.
+ *
+ * Uses AVX2 or SSE4.1 when the CPU supports them, with a scalar fallback.
+ *
+ * @param rows receives the indices of the accepted rows in ascending order,
+ * must hold columns->count elements.
+ * @retval size_t count of the accepted rows.
+ */
+size_t filter_rows(const ContainerColumns *columns, const RowFilter *filter, size_t *rows);
+
+// Count and total capacity of the containers of one group.
+typedef struct {
+    uint64_t count;
+    int64_t capacity;
+} GroupTotals;
+
+/**
+ * @brief Counts the rows accepted by the filter and sums their capacities
+ * per waste type in one pass, without listing the rows.
+ *
+ * Uses AVX2 when the CPU supports it.
+ *
+ * @param totals receives TYPE_BITS_COUNT groups, indexed by the position of
+ * the type bit: WASTE_TYPE_ORDER, then the other types.
+ */
+void sum_by_type(const ContainerColumns *columns, const RowFilter *filter, GroupTotals *totals);
+
+/**
+ * @brief Adds the given rows to the totals of their groups.
+ *
+ * @param group_of_row group index of every row of the columns.
+ * @param totals groups the rows are added to, not cleared before.
+ */
+void sum_rows_by_group(const ContainerColumns *columns, const size_t *rows, size_t count, const size_t *group_of_row,
+                       GroupTotals *totals);
+
+#endif // FILTER_H
@@ -0,0 +1,741 @@
+#include "listing.h"
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bitmap.h"
+#include "columnar.h"
+#include "dataset.h"
+#include "stations.h"
+
+// Matching rows of the container listing, rendered in ascending order.
+typedef struct {
+    const Filters *filters;
+    const size_t *rows;
+} Selection;
+
+typedef struct {
+    const char *id;
+    double distance;
+} Neighbor;
+
+// Names accepted by -f and labels printed in the listing, indexed by ListingField
+static const struct {
+    const char *name;
+    const char *label;
+} listing_fields[LISTING_FIELDS_COUNT] = {
+    { "id", "ID: " },
+    { "type", "Type: " },
+    { "capacity", "Capacity: " },
+    { "address", "Address: " },
+    { "neighbors", "Neighbors: " },
+};
+
+/* Neighbors of the streamed listing, read from the sorted edges already in
+ * ascending order and without duplicates. The IDs are kept in the same
+ * allocation, after the neighbors. */
+static Neighbor *find_streamed_neighbors(const char *given_container_id, size_t *neighbors_count) {
+    uint32_t id;
+    uint32_t *targets;
+    *neighbors_count = 0;
+    if (!parse_numeric_id(given_container_id, &id)) {
+        // Every path has numeric IDs, so a container with another ID has none
+        return NULL;
+    }
+    if (!find_edges(neighbor_edges(), id, &targets, neighbors_count)) {
+        fprintf(stderr, "Reading the sorted paths failed.\n");
+        return NULL;
+    }
+    Neighbor *neighbors = malloc(*neighbors_count * (sizeof(Neighbor) + NUMERIC_ID_DIGITS + 1));
+    if (neighbors == NULL) {
+        *neighbors_count = 0;
+        free(targets);
+        return NULL;
+    }
+    char *ids = (char *) (neighbors + *neighbors_count);
+    for (size_t i = 0; i < *neighbors_count; i++) {
+        char *neighbor_id = ids + i * (NUMERIC_ID_DIGITS + 1);
+        snprintf(neighbor_id, NUMERIC_ID_DIGITS + 1, "%" PRIu32, targets[i]);
+        neighbors[i] = (Neighbor) { neighbor_id, 0.0 };
+    }
+    free(targets);
+    return neighbors;
+}
+
+static Neighbor *find_neighbors(const char *given_container_id, size_t *neighbors_count) {
+    Neighbor *neighbors = NULL;
+    *neighbors_count = 0;
+    if (neighbor_edges() != NULL) {
+        return find_streamed_neighbors(given_container_id, neighbors_count);
+    }
+
+    for (size_t i = 0; i < paths_count(); i++) {
+        const char *container_a_id = path_field(i, PATH_A);
+        const char *container_b_id = path_field(i, PATH_B);
+
+        if (strcmp(given_container_id, container_a_id) == 0 ||
+            strcmp(given_container_id, container_b_id) == 0) {
+            const char *neighbor_id = strcmp(given_container_id, container_a_id) == 0 ? container_b_id : container_a_id;
+            double distance = strtod(path_field(i, PATH_DISTANCE), NULL);
+
+            neighbors = realloc(neighbors, (*neighbors_count + 1) * sizeof(Neighbor));
+            neighbors[*neighbors_count].id = neighbor_id;
+            neighbors[*neighbors_count].distance = distance;
+            (*neighbors_count)++;
+        }
+    }
+
+    Neighbor temp;
+  //Sort array using the Babble Sort algorithm
+  for(size_t i=0; i<*neighbors_count; i++){
+    for(size_t j=0; j<*neighbors_count-1-i; j++){
+      if(atoi(neighbors[j].id)> atoi(neighbors[j+1].id)){
+        //swap array[j] and array[j+1]
+        temp = neighbors[j];
+        neighbors[j]=neighbors[j+1];
+        neighbors[j+1]=temp;
+      }
+    }
+ }   
+
+    int unique_count = 0;
+    for(size_t i = 0; i + 1 < *neighbors_count; i++){
+        if(atoi(neighbors[i].id)!= atoi(neighbors[i+1].id)){
+            neighbors[unique_count++] = neighbors[i];
+        }
+    }
+
+    if(*neighbors_count > 0){
+        neighbors[unique_count++] = neighbors[*neighbors_count - 1];
+    }
+
+    *neighbors_count = unique_count;
+    
+    return neighbors; // Caller should free the memory allocated for neighbors
+}
+
+/* Evaluates -t and -p as word-wide OR and AND over the row bitmaps and -c
+ * as a range of the capacity index found by two binary searches. The rows
+ * of the range are marked in a bitmap as well, so the intersection keeps
+ * the rows in the order of the file. */
+static bool select_indexed(const Filters *filters, size_t *rows, size_t *selected_count) {
+    size_t count = containers_count();
+    size_t words = bitmap_words(count);
+    uint64_t *selected = create_bitmap(count);
+    uint64_t *in_range = create_bitmap(count);
+    if (selected == NULL || in_range == NULL) {
+        free(selected);
+        free(in_range);
+        return false;
+    }
+
+    if (filters->waste_type_count == 0) {
+        bitmap_fill(selected, count);
+    } else {
+        for (size_t j = 0; j < filters->waste_type_count; j++) {
+            int type = waste_type_index_of(filters->waste_types[j][0]);
+            if (type >= 0) {
+                bitmap_or(selected, type_bitmap(type), words);
+            }
+        }
+    }
+    if (filters->public_filter >= 0) {
+        bitmap_and(selected, public_bitmap(filters->public_filter), words);
+    }
+    if (filters->capacity_min != 0 || filters->capacity_max != 0) {
+        size_t begin = capacity_lower_bound(filters->capacity_min);
+        size_t end = filters->capacity_max < filters->capacity_min ? begin
+                     : filters->capacity_max == INT_MAX ? count : capacity_lower_bound(filters->capacity_max + 1);
+        for (size_t k = begin; k < end; k++) {
+            bitmap_set(in_range, row_by_capacity(k));
+        }
+        bitmap_and(selected, in_range, words);
+    }
+
+    *selected_count = bitmap_to_rows(selected, words, rows);
+    free(selected);
+    free(in_range);
+    return true;
+}
+
+RowFilter row_filter(const Filters *filters) {
+    RowFilter filter = { 0xff, NOT_PUBLIC_BIT | PUBLIC_BIT, INT32_MIN, INT32_MAX };
+    if (filters->waste_type_count > 0) {
+        filter.type_mask = 0;
+        for (size_t j = 0; j < filters->waste_type_count; j++) {
+            int type = waste_type_index_of(filters->waste_types[j][0]);
+            if (type >= 0) {
+                filter.type_mask |= (uint8_t) (1u << type);
+            }
+        }
+    }
+    if (filters->public_filter >= 0) {
+        filter.public_mask = filters->public_filter ? PUBLIC_BIT : NOT_PUBLIC_BIT;
+    }
+    if (filters->capacity_min != 0 || filters->capacity_max != 0) {
+        filter.capacity_min = filters->capacity_min;
+        filter.capacity_max = filters->capacity_max;
+    }
+    return filter;
+}
+
+/* Lists the rows matching the filters in the order of the file. Queries
+ * and, without indexes, the plain filters start with one pass of the
+ * filter kernel over all rows. */
+static size_t *select_containers(const Filters *filters, size_t *selected_count) {
+    size_t *rows = malloc((containers_count() + 1) * sizeof(size_t));
+    if (rows == NULL) {
+        return NULL;
+    }
+
+    if (filters->query != NULL) {
+        RowFilter filter = row_filter(filters);
+        if (!run_query(filters->query, &filter, container_columns(), rows, selected_count)) {
+            free(rows);
+            return NULL;
+        }
+    } else if (container_indexes_built()) {
+        if (!select_indexed(filters, rows, selected_count)) {
+            free(rows);
+            return NULL;
+        }
+    } else {
+        RowFilter filter = row_filter(filters);
+        *selected_count = filter_rows(container_columns(), &filter, rows);
+    }
+    return rows;
+}
+
+static void render_neighbors(Writer *out, size_t i) {
+    size_t neighbors_count;
+    Neighbor *neighbors = find_neighbors(container_field(i, 0), &neighbors_count);
+    for (size_t j = 0; j < neighbors_count; j++) {
+        write_string(out, neighbors[j].id);
+        if (j < neighbors_count - 1) {
+            write_char(out, ' ');
+        }
+    }
+    free(neighbors);
+}
+
+static void render_container(Writer *out, size_t i, const Filters *filters) {
+    for (size_t f = 0; f < filters->fields_count; f++) {
+        if (f > 0) {
+            write_literal(out, ", ");
+        }
+        write_string(out, listing_fields[filters->fields[f]].label);
+
+        switch (filters->fields[f]) {
+            case FIELD_ID:
+                write_string(out, container_field(i, CONTAINER_ID));
+                break;
+            case FIELD_TYPE:
+                write_string(out, container_field(i, CONTAINER_WASTE_TYPE));
+                break;
+            case FIELD_CAPACITY:
+                write_string(out, container_field(i, CONTAINER_CAPACITY));
+                break;
+            case FIELD_ADDRESS:
+                write_string(out, container_field(i, CONTAINER_STREET));
+                write_char(out, ' ');
+                write_string(out, container_field(i, CONTAINER_NUMBER));
+                break;
+            case FIELD_NEIGHBORS:
+                render_neighbors(out, i);
+                break;
+        }
+    }
+    write_char(out, '\n');
+}
+
+static void render_containers(Writer *out, size_t begin, size_t end, const void *context) {
+    const Selection *selection = context;
+    for (size_t k = begin; k < end; k++) {
+        render_container(out, selection->rows[k], selection->filters);
+    }
+}
+
+// One JSON object per line, the capacity as a number and IDs as strings.
+static void render_container_json(Writer *out, size_t i, const Filters *filters) {
+    write_char(out, '{');
+    for (size_t f = 0; f < filters->fields_count; f++) {
+        if (f > 0) {
+            write_char(out, ',');
+        }
+        write_json_string(out, listing_fields[filters->fields[f]].name);
+        write_char(out, ':');
+
+        switch (filters->fields[f]) {
+            case FIELD_ID:
+                write_json_string(out, container_field(i, CONTAINER_ID));
+                break;
+            case FIELD_TYPE:
+                write_json_string(out, container_field(i, CONTAINER_WASTE_TYPE));
+                break;
+            case FIELD_CAPACITY:
+                write_uint(out, strtoul(container_field(i, CONTAINER_CAPACITY), NULL, 10));
+                break;
+            case FIELD_ADDRESS:
+                // Street and number are joined the same way as in the text listing
+                write_char(out, '"');
+                write_json_chars(out, container_field(i, CONTAINER_STREET));
+                write_char(out, ' ');
+                write_json_chars(out, container_field(i, CONTAINER_NUMBER));
+                write_char(out, '"');
+                break;
+            case FIELD_NEIGHBORS: {
+                size_t neighbors_count;
+                Neighbor *neighbors = find_neighbors(container_field(i, CONTAINER_ID), &neighbors_count);
+                write_char(out, '[');
+                for (size_t j = 0; j < neighbors_count; j++) {
+                    if (j > 0) {
+                        write_char(out, ',');
+                    }
+                    write_json_string(out, neighbors[j].id);
+                }
+                write_char(out, ']');
+                free(neighbors);
+                break;
+            }
+        }
+    }
+    write_literal(out, "}\n");
+}
+
+static void render_containers_json(Writer *out, size_t begin, size_t end, const void *context) {
+    const Selection *selection = context;
+    for (size_t k = begin; k < end; k++) {
+        render_container_json(out, selection->rows[k], selection->filters);
+    }
+}
+
+static const ColumnKind listing_field_kinds[LISTING_FIELDS_COUNT] = {
+    COLUMN_STRING, COLUMN_STRING, COLUMN_U64, COLUMN_STRING, COLUMN_STRING_LIST
+};
+
+static bool print_containers_columnar(Writer *out, const Filters *filters, const size_t *rows, size_t rows_count) {
+    ColumnarTable table;
+    init_columnar_table(&table);
+    Column *columns[LISTING_FIELDS_COUNT];
+    for (size_t f = 0; f < filters->fields_count; f++) {
+        columns[f] = add_column(&table, listing_fields[filters->fields[f]].name, listing_field_kinds[filters->fields[f]]);
+        if (columns[f] == NULL) {
+            destroy_columnar_table(&table);
+            return false;
+        }
+    }
+
+    table.rows = rows_count;
+    for (size_t k = 0; k < rows_count; k++) {
+        size_t row = rows[k];
+        for (size_t f = 0; f < filters->fields_count; f++) {
+            Column *column = columns[f];
+            switch (filters->fields[f]) {
+                case FIELD_ID:
+                    append_string(column, container_field(row, CONTAINER_ID), strlen(container_field(row, CONTAINER_ID)));
+                    break;
+                case FIELD_TYPE:
+                    append_string(column, container_field(row, CONTAINER_WASTE_TYPE), strlen(container_field(row, CONTAINER_WASTE_TYPE)));
+                    break;
+                case FIELD_CAPACITY:
+                    append_u64(column, strtoull(container_field(row, CONTAINER_CAPACITY), NULL, 10));
+                    break;
+                case FIELD_ADDRESS:
+                    append_string_part(column, container_field(row, CONTAINER_STREET), strlen(container_field(row, CONTAINER_STREET)));
+                    append_string_part(column, " ", 1);
+                    append_string(column, container_field(row, CONTAINER_NUMBER), strlen(container_field(row, CONTAINER_NUMBER)));
+                    break;
+                case FIELD_NEIGHBORS: {
+                    size_t neighbors_count;
+                    Neighbor *neighbors = find_neighbors(container_field(row, CONTAINER_ID), &neighbors_count);
+                    for (size_t j = 0; j < neighbors_count; j++) {
+                        append_string(column, neighbors[j].id, strlen(neighbors[j].id));
+                    }
+                    end_list(column);
+                    free(neighbors);
+                    break;
+                }
+            }
+        }
+    }
+
+    bool ok = write_columnar_table(out, &table);
+    destroy_columnar_table(&table);
+    return ok;
+}
+
+int listing_field_index(const char *name, size_t length) {
+    for (int field = 0; field < LISTING_FIELDS_COUNT; field++) {
+        if (strlen(listing_fields[field].name) == length && strncmp(listing_fields[field].name, name, length) == 0) {
+            return field;
+        }
+    }
+    return -1;
+}
+
+bool listing_needs_paths(const Filters *filters) {
+    return filters->aggregate == AGGREGATE_NONE && memchr(filters->fields, FIELD_NEIGHBORS, filters->fields_count) != NULL;
+}
+
+// Totals of the non-empty groups of an aggregation.
+typedef struct {
+    AggregateGroup group;
+    size_t count;
+    size_t *keys;           // Type bit position, station index or the first row on the street
+    GroupTotals *totals;
+} Aggregation;
+
+// Keeps the non-empty groups of totals, with their indices as keys.
+static bool keep_nonempty_groups(Aggregation *aggregation, GroupTotals *totals, size_t groups_count) {
+    aggregation->keys = malloc((groups_count + 1) * sizeof(size_t));
+    if (aggregation->keys == NULL) {
+        return false;
+    }
+    aggregation->totals = totals;
+    aggregation->count = 0;
+    for (size_t g = 0; g < groups_count; g++) {
+        if (totals[g].count > 0) {
+            aggregation->keys[aggregation->count] = g;
+            totals[aggregation->count++] = totals[g];
+        }
+    }
+    return true;
+}
+
+/* Without a query, the type totals are summed in one pass of the filter
+ * kernel over the columns, without listing the rows. */
+static bool aggregate_by_type(const Filters *filters, Aggregation *aggregation) {
+    GroupTotals *totals = calloc(TYPE_BITS_COUNT, sizeof(GroupTotals));
+    if (totals == NULL) {
+        return false;
+    }
+
+    RowFilter filter = row_filter(filters);
+    if (filters->query == NULL) {
+        sum_by_type(container_columns(), &filter, totals);
+    } else {
+        size_t rows_count;
+        size_t *rows = select_containers(filters, &rows_count);
+        if (rows == NULL) {
+            free(totals);
+            return false;
+        }
+        for (size_t k = 0; k < rows_count; k++) {
+            GroupTotals *group = &totals[__builtin_ctz(container_columns()->type_bits[rows[k]])];
+            group->count++;
+            group->capacity += container_columns()->capacity[rows[k]];
+        }
+        free(rows);
+    }
+
+    if (!keep_nonempty_groups(aggregation, totals, TYPE_BITS_COUNT)) {
+        free(totals);
+        return false;
+    }
+    return true;
+}
+
+static bool aggregate_by_station(const Filters *filters, Aggregation *aggregation) {
+    const StationGraph *graph = get_station_graph();
+    size_t rows_count;
+    size_t *rows = graph == NULL ? NULL : select_containers(filters, &rows_count);
+    GroupTotals *totals = graph == NULL ? NULL : calloc(graph->stations_count + 1, sizeof(GroupTotals));
+    bool ok = rows != NULL && totals != NULL;
+    if (ok) {
+        sum_rows_by_group(container_columns(), rows, rows_count, graph->station_of_row, totals);
+        ok = keep_nonempty_groups(aggregation, totals, graph->stations_count);
+    }
+    if (!ok) {
+        free(totals);
+    }
+    free(rows);
+    return ok;
+}
+
+// FNV-1a hash of the string.
+static uint64_t hash_string(const char *string) {
+    uint64_t hash = 14695981039346656037ull;
+    for (; *string != '\0'; string++) {
+        hash = (hash ^ (unsigned char) *string) * 1099511628211ull;
+    }
+    return hash;
+}
+
+/* Streets are grouped by an open addressing table keyed by the street name;
+ * a group is created by the first selected row on its street. */
+static bool aggregate_by_street(const Filters *filters, Aggregation *aggregation) {
+    size_t rows_count;
+    size_t *rows = select_containers(filters, &rows_count);
+    if (rows == NULL) {
+        return false;
+    }
+
+    size_t slots_count = 16;
+    while (slots_count < 2 * rows_count) {
+        slots_count *= 2;
+    }
+    size_t *slots = malloc(slots_count * sizeof(size_t));     // Group index + 1, 0 for an empty slot
+    aggregation->keys = malloc((rows_count + 1) * sizeof(size_t));
+    aggregation->totals = calloc(rows_count + 1, sizeof(GroupTotals));
+    if (slots == NULL || aggregation->keys == NULL || aggregation->totals == NULL) {
+        free(rows);
+        free(slots);
+        free(aggregation->keys);
+        free(aggregation->totals);
+        return false;
+    }
+    memset(slots, 0, slots_count * sizeof(size_t));
+
+    aggregation->count = 0;
+    for (size_t k = 0; k < rows_count; k++) {
+        const char *street = container_field(rows[k], CONTAINER_STREET);
+        size_t slot = (size_t) hash_string(street) & (slots_count - 1);
+        while (slots[slot] != 0
+               && strcmp(container_field(aggregation->keys[slots[slot] - 1], CONTAINER_STREET), street) != 0) {
+            slot = (slot + 1) & (slots_count - 1);
+        }
+        if (slots[slot] == 0) {
+            aggregation->keys[aggregation->count++] = rows[k];
+            slots[slot] = aggregation->count;
+        }
+
+        GroupTotals *group = &aggregation->totals[slots[slot] - 1];
+        group->count++;
+        group->capacity += container_columns()->capacity[rows[k]];
+    }
+
+    free(slots);
+    free(rows);
+    return true;
+}
+
+// Writes the group name, escaped as a JSON string if json is set; station IDs are numbers in both.
+static void render_group_label(Writer *out, const Aggregation *aggregation, size_t g, bool json) {
+    size_t key = aggregation->keys[g];
+    if (aggregation->group == AGGREGATE_STATION) {
+        write_uint(out, key + 1);
+        return;
+    }
+
+    char type[2] = { key < WASTE_TYPES_COUNT ? WASTE_TYPE_ORDER[key] : '\0', '\0' };
+    const char *label = aggregation->group == AGGREGATE_STREET ? container_field(key, CONTAINER_STREET)
+                        : key < WASTE_TYPES_COUNT ? type : "other";
+    if (json) {
+        write_json_string(out, label);
+    } else {
+        write_string(out, label);
+    }
+}
+
+static void render_aggregation(Writer *out, const Aggregation *aggregation, OutputFormat format) {
+    for (size_t g = 0; g < aggregation->count; g++) {
+        if (format == FORMAT_NDJSON) {
+            write_literal(out, "{\"group\":");
+            render_group_label(out, aggregation, g, true);
+            write_literal(out, ",\"count\":");
+            write_uint(out, aggregation->totals[g].count);
+            write_literal(out, ",\"capacity\":");
+            write_int(out, aggregation->totals[g].capacity);
+            write_literal(out, "}\n");
+        } else {
+            render_group_label(out, aggregation, g, false);
+            write_char(out, ';');
+            write_uint(out, aggregation->totals[g].count);
+            write_char(out, ';');
+            write_int(out, aggregation->totals[g].capacity);
+            write_char(out, '\n');
+        }
+    }
+}
+
+static bool print_aggregation_columnar(Writer *out, const Aggregation *aggregation) {
+    ColumnarTable table;
+    init_columnar_table(&table);
+    bool stations = aggregation->group == AGGREGATE_STATION;
+    Column *groups = add_column(&table, "group", stations ? COLUMN_U64 : COLUMN_STRING);
+    Column *counts = add_column(&table, "count", COLUMN_U64);
+    Column *capacities = add_column(&table, "capacity", COLUMN_U64);
+    if (groups == NULL || counts == NULL || capacities == NULL) {
+        destroy_columnar_table(&table);
+        return false;
+    }
+
+    table.rows = aggregation->count;
+    Writer label;
+    bool ok = init_writer(&label, -1);
+    for (size_t g = 0; ok && g < aggregation->count; g++) {
+        if (stations) {
+            append_u64(groups, aggregation->keys[g] + 1);
+        } else {
+            label.length = 0;
+            render_group_label(&label, aggregation, g, false);
+            append_string(groups, label.data, label.length);
+        }
+        append_u64(counts, aggregation->totals[g].count);
+        append_u64(capacities, (uint64_t) aggregation->totals[g].capacity);
+    }
+
+    ok = ok && !label.failed && write_columnar_table(out, &table);
+    destroy_writer(&label);
+    destroy_columnar_table(&table);
+    return ok;
+}
+
+static bool print_aggregation(Writer *out, const Filters *filters) {
+    Aggregation aggregation = { filters->aggregate, 0, NULL, NULL };
+    bool ok;
+    switch (filters->aggregate) {
+        case AGGREGATE_TYPE:
+            ok = aggregate_by_type(filters, &aggregation);
+            break;
+        case AGGREGATE_STATION:
+            ok = aggregate_by_station(filters, &aggregation);
+            break;
+        default:
+            ok = aggregate_by_street(filters, &aggregation);
+            break;
+    }
+
+    if (ok && filters->format == FORMAT_COLUMNAR) {
+        ok = print_aggregation_columnar(out, &aggregation);
+    } else if (ok) {
+        render_aggregation(out, &aggregation, filters->format);
+        ok = !out->failed;
+    }
+    free(aggregation.keys);
+    free(aggregation.totals);
+    if (!ok) {
+        fprintf(stderr, "Memory allocation failed.\n");
+    }
+    return ok;
+}
+
+bool print_containers(Writer *out, Filters filters) {
+    if (filters.aggregate != AGGREGATE_NONE) {
+        return print_aggregation(out, &filters);
+    }
+
+    size_t rows_count;
+    size_t *rows = select_containers(&filters, &rows_count);
+    bool ok = rows != NULL;
+    if (ok && filters.format == FORMAT_COLUMNAR) {
+        ok = print_containers_columnar(out, &filters, rows, rows_count);
+    } else if (ok) {
+        Selection selection = { &filters, rows };
+        ok = render_parallel(out, rows_count, filters.threads,
+                             filters.format == FORMAT_NDJSON ? render_containers_json : render_containers, &selection);
+    }
+    free(rows);
+    if (!ok) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return false;
+    }
+    return true;
+}
+
+void render_listing(Writer *out, const Filters *filters, const size_t *rows, size_t rows_count) {
+    Selection selection = { filters, rows };
+    if (filters->format == FORMAT_NDJSON) {
+        render_containers_json(out, 0, rows_count, &selection);
+    } else {
+        render_containers(out, 0, rows_count, &selection);
+    }
+}
+
+static void render_stations(Writer *out, size_t begin, size_t end, const void *context) {
+    const StationGraph *graph = context;
+    for (size_t i = begin; i < end; i++) {
+        write_uint(out, i + 1);
+        write_char(out, ';');
+        for (int type = 0; type < WASTE_TYPES_COUNT; type++) {
+            if (graph->waste_mask[i] & (1u << type)) {
+                write_char(out, WASTE_TYPE_ORDER[type]);
+            }
+        }
+        write_char(out, ';');
+
+        // Neighbors are kept sorted and unique by the graph
+        for (size_t e = graph->adjacency_offsets[i]; e < graph->adjacency_offsets[i + 1]; e++) {
+            write_uint(out, graph->adjacency[e] + 1);
+            if (e < graph->adjacency_offsets[i + 1] - 1) {
+                write_char(out, ',');
+            }
+        }
+        write_char(out, '\n');
+    }
+}
+
+static void render_stations_json(Writer *out, size_t begin, size_t end, const void *context) {
+    const StationGraph *graph = context;
+    for (size_t i = begin; i < end; i++) {
+        write_literal(out, "{\"id\":");
+        write_uint(out, i + 1);
+        write_literal(out, ",\"types\":\"");
+        for (int type = 0; type < WASTE_TYPES_COUNT; type++) {
+            if (graph->waste_mask[i] & (1u << type)) {
+                write_char(out, WASTE_TYPE_ORDER[type]);
+            }
+        }
+        write_literal(out, "\",\"neighbors\":[");
+        for (size_t e = graph->adjacency_offsets[i]; e < graph->adjacency_offsets[i + 1]; e++) {
+            if (e > graph->adjacency_offsets[i]) {
+                write_char(out, ',');
+            }
+            write_uint(out, graph->adjacency[e] + 1);
+        }
+        write_literal(out, "]}\n");
+    }
+}
+
+static bool print_stations_columnar(Writer *out, const StationGraph *graph) {
+    ColumnarTable table;
+    init_columnar_table(&table);
+    Column *ids = add_column(&table, "id", COLUMN_U64);
+    Column *types = add_column(&table, "types", COLUMN_STRING);
+    Column *neighbors = add_column(&table, "neighbors", COLUMN_U64_LIST);
+    if (ids == NULL || types == NULL || neighbors == NULL) {
+        destroy_columnar_table(&table);
+        return false;
+    }
+
+    table.rows = graph->stations_count;
+    for (size_t i = 0; i < graph->stations_count; i++) {
+        append_u64(ids, i + 1);
+        for (int type = 0; type < WASTE_TYPES_COUNT; type++) {
+            if (graph->waste_mask[i] & (1u << type)) {
+                append_string_part(types, &WASTE_TYPE_ORDER[type], 1);
+            }
+        }
+        end_string(types);
+        for (size_t e = graph->adjacency_offsets[i]; e < graph->adjacency_offsets[i + 1]; e++) {
+            append_u64(neighbors, graph->adjacency[e] + 1);
+        }
+        end_list(neighbors);
+    }
+
+    bool ok = write_columnar_table(out, &table);
+    destroy_columnar_table(&table);
+    return ok;
+}
+
+bool print_stations(Writer *out, Filters filters) {
+    const StationGraph *graph = get_station_graph();
+    if (graph == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return false;
+    }
+
+    bool ok;
+    if (filters.format == FORMAT_COLUMNAR) {
+        ok = print_stations_columnar(out, graph);
+    } else {
+        ok = render_parallel(out, graph->stations_count, filters.threads,
+                             filters.format == FORMAT_NDJSON ? render_stations_json : render_stations, graph);
+    }
+    if (!ok) {
+        fprintf(stderr, "Memory allocation failed.\n");
+    }
+    return ok;
+}
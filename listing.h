@@ -0,0 +1,107 @@
+#ifndef LISTING_H
+#define LISTING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "filter.h"
+#include "query.h"
+#include "writer.h"
+
+// Fields of the container listing in their default order.
+typedef enum {
+    FIELD_ID,
+    FIELD_TYPE,
+    FIELD_CAPACITY,
+    FIELD_ADDRESS,
+    FIELD_NEIGHBORS,
+    LISTING_FIELDS_COUNT
+} ListingField;
+
+/**
+ * @brief Finds the listing field by its name, e.g. "capacity".
+ *
+ * @param length length of the name, which need not be null-terminated.
+ * @retval int the ListingField.
+ * @retval -1 for an unknown name.
+ */
+int listing_field_index(const char *name, size_t length);
+
+// Output formats selected by --format.
+typedef enum {
+    FORMAT_TEXT,
+    FORMAT_NDJSON,      // One JSON object per line
+    FORMAT_COLUMNAR     // Binary columns, see columnar.h
+} OutputFormat;
+
+// Groups of the totals printed by -a instead of the listing.
+typedef enum {
+    AGGREGATE_NONE,
+    AGGREGATE_TYPE,
+    AGGREGATE_STATION,
+    AGGREGATE_STREET
+} AggregateGroup;
+
+typedef struct {
+    char waste_types[8][2];
+    size_t waste_type_count;
+    int capacity_min;
+    int capacity_max;
+    int public_filter;          // 1 public only, 0 non-public only, -1 all
+    const char *containers_path;
+    const char *paths_path;
+    int special_flag;
+    int route_flag;
+    size_t route_from;
+    size_t route_to;
+    int route_via;
+    size_t k_paths;
+    const char *depots;
+    int accessibility_flag;
+    unsigned threads;           // Threads of the shared scheduler and of a server, set by -j
+    unsigned char fields[LISTING_FIELDS_COUNT]; // ListingField values in the order of output
+    size_t fields_count;
+    OutputFormat format;
+    Query *query;               // Compiled -q expression, NULL if not given
+    const char *batch_path;     // File with one listing per line given by -b, "-" for stdin
+    const char *batch_output;   // Directory of the batch outputs given by -o, NULL for stdout
+    AggregateGroup aggregate;   // Set by -a
+    size_t top_count;           // Stations ranked by --top, 0 if not given
+    int top_type;               // Index in WASTE_TYPE_ORDER ranked by --by, -1 for all types
+    const char *serve_path;     // Unix socket of the server given by --serve, NULL if not given
+    const char *publish_path;   // Snapshot written by --publish, NULL if not given
+    const char *attach_path;    // Snapshot read by --attach instead of the input files, NULL if not given
+    int stream_flag;            // Listing streamed while the files are read, set by --stream
+    size_t sort_memory;         // Bytes of memory of a sort of the paths, set by --sort-memory, 0 for the default
+    const char *temp_dir;       // Directory of the temporary files of the sorts given by --temp-dir, NULL if not given
+} Filters;
+
+// Whether the container listing with the given filters prints any path data.
+bool listing_needs_paths(const Filters *filters);
+
+/**
+ * @brief Prints the containers matching the filters, or with -a their count
+ * and total capacity per group, one group per line: "group;count;capacity".
+ *
+ * Groups are printed in the order of WASTE_TYPE_ORDER, followed by "other"
+ * types, of station IDs or of the first container on the street. Groups
+ * without any matching container are left out.
+ *
+ * @retval false on memory failure.
+ */
+bool print_containers(Writer *out, Filters filters);
+
+/**
+ * @brief Prints the stations with their waste types and neighboring
+ * stations, one per line: "ID;types;neighbor,neighbor".
+ *
+ * @retval false on memory failure.
+ */
+bool print_stations(Writer *out, Filters filters);
+
+// Turns the filters into the masks and the range of the filter kernel.
+RowFilter row_filter(const Filters *filters);
+
+// Renders the rows as the text or ndjson listing of the filters, on the calling thread.
+void render_listing(Writer *out, const Filters *filters, const size_t *rows, size_t rows_count);
+
+#endif // LISTING_H
@@ -0,0 +1,477 @@
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "loader.h"
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define HAVE_IO_URING 1
+#endif
+
+// Threads of the pread() fallback.
+#define LOADER_THREADS 4
+
+typedef struct {
+    LoadedFile file;
+    int fd;
+    size_t chunks_count;
+    size_t chunks_issued;
+    size_t chunks_arrived;      // Chunks read from the start of the file without a gap
+    bool failed;                // Published to file.failed by wait_for_loading()
+    size_t *chunk_filled;       // Bytes of each chunk read so far
+    struct iovec *vectors;      // Target of the read in flight of each chunk
+} InputFile;
+
+#ifdef HAVE_IO_URING
+// Submission and completion queues shared with the kernel.
+typedef struct {
+    int fd;
+    unsigned entries;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    unsigned pending;           // Queued but not yet submitted
+} Ring;
+#endif
+
+struct Loader {
+    InputFile *files;
+    size_t count;
+    size_t next_file;           // Round robin over the files issuing their next chunk
+    size_t in_flight;
+#ifdef HAVE_IO_URING
+    bool uring;
+    Ring ring;
+#endif
+    // pread() fallback
+    pthread_t threads[LOADER_THREADS];
+    unsigned threads_count;
+    pthread_mutex_t lock;
+    pthread_cond_t progress;    // A chunk arrived or a file failed
+    size_t completions;
+    size_t completions_seen;
+    bool stopping;
+};
+
+bool loader_threads_only = false;
+
+static size_t chunk_length(const InputFile *input, size_t chunk) {
+    size_t offset = chunk * LOADER_CHUNK_SIZE;
+    return input->file.size - offset < LOADER_CHUNK_SIZE ? input->file.size - offset : LOADER_CHUNK_SIZE;
+}
+
+// Reads a file that has no size or cannot be read at an offset, e.g. a pipe, in one go.
+static bool read_sequentially(InputFile *input) {
+    size_t capacity = LOADER_CHUNK_SIZE;
+    input->file.data = malloc(capacity + 1);
+    if (input->file.data == NULL) {
+        return false;
+    }
+    for (;;) {
+        if (input->file.size == capacity) {
+            char *data = realloc(input->file.data, capacity * 2 + 1);
+            if (data == NULL) {
+                return false;
+            }
+            input->file.data = data;
+            capacity *= 2;
+        }
+        ssize_t count = read(input->fd, input->file.data + input->file.size, capacity - input->file.size);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            return false;
+        }
+        if (count == 0) {
+            break;
+        }
+        input->file.size += (size_t) count;
+    }
+    input->file.data[input->file.size] = '\0';
+    input->file.arrived = input->file.size;
+    return true;
+}
+
+// Opens the file and prepares the reads of its chunks; false marks it as failed.
+static bool open_input(InputFile *input, const char *path) {
+    input->fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat status;
+    if (input->fd < 0 || fstat(input->fd, &status) != 0) {
+        return false;
+    }
+    if (!S_ISREG(status.st_mode)) {
+        return read_sequentially(input);
+    }
+
+    input->file.size = (size_t) status.st_size;
+    input->chunks_count = (input->file.size + LOADER_CHUNK_SIZE - 1) / LOADER_CHUNK_SIZE;
+    input->file.data = malloc(input->file.size + 1);
+    input->chunk_filled = calloc(input->chunks_count + 1, sizeof(size_t));
+    input->vectors = malloc((input->chunks_count + 1) * sizeof(struct iovec));
+    if (input->file.data == NULL || input->chunk_filled == NULL || input->vectors == NULL) {
+        return false;
+    }
+    input->file.data[input->file.size] = '\0';
+    return true;
+}
+
+// Adds the read bytes to the chunk; a read of nothing means the file got shorter.
+static void record_read(InputFile *input, size_t chunk, ssize_t result) {
+    if (result <= 0) {
+        input->failed = true;
+        return;
+    }
+    input->chunk_filled[chunk] += (size_t) result;
+}
+
+static bool chunk_complete(const InputFile *input, size_t chunk) {
+    return input->chunk_filled[chunk] == chunk_length(input, chunk);
+}
+
+// Picks the next chunk to read, taking the files in turn; false if all are issued.
+static bool next_chunk(Loader *loader, size_t *file, size_t *chunk) {
+    for (size_t k = 0; k < loader->count; k++) {
+        size_t index = (loader->next_file + k) % loader->count;
+        InputFile *input = &loader->files[index];
+        if (!input->failed && input->chunks_issued < input->chunks_count) {
+            *file = index;
+            *chunk = input->chunks_issued++;
+            loader->next_file = index + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef HAVE_IO_URING
+// Identifies a read by its file and chunk in the user data of the queue entries.
+#define USER_DATA(file, chunk) ((uint64_t) (file) << 48 | (uint64_t) (chunk))
+#define USER_DATA_FILE(data) ((size_t) ((data) >> 48))
+#define USER_DATA_CHUNK(data) ((size_t) ((data) & ((1ull << 48) - 1)))
+
+static bool setup_ring(Ring *ring, unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) {
+        return false;
+    }
+
+    ring->entries = params.sq_entries;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single && ring->cq_ring_size > ring->sq_ring_size) {
+        ring->sq_ring_size = ring->cq_ring_size;
+    }
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, IORING_OFF_SQ_RING);
+    ring->cq_ring = single ? ring->sq_ring
+                           : mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd,
+                                  IORING_OFF_CQ_RING);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, IORING_OFF_SQES);
+    if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        if (ring->sq_ring != MAP_FAILED) {
+            munmap(ring->sq_ring, ring->sq_ring_size);
+        }
+        if (!single && ring->cq_ring != MAP_FAILED) {
+            munmap(ring->cq_ring, ring->cq_ring_size);
+        }
+        if (ring->sqes != MAP_FAILED) {
+            munmap(ring->sqes, ring->sqes_size);
+        }
+        close(ring->fd);
+        return false;
+    }
+    if (single) {
+        ring->cq_ring_size = 0;
+    }
+
+    char *sq = ring->sq_ring;
+    char *cq = ring->cq_ring;
+    ring->sq_head = (unsigned *) (sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) (sq + params.sq_off.array);
+    ring->cq_head = (unsigned *) (cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+    ring->pending = 0;
+    return true;
+}
+
+static void close_ring(Ring *ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring_size > 0) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+}
+
+// Queues the read of the rest of the chunk; submitted by the next enter_ring().
+static void queue_read(Loader *loader, size_t file, size_t chunk) {
+    Ring *ring = &loader->ring;
+    InputFile *input = &loader->files[file];
+    size_t offset = chunk * LOADER_CHUNK_SIZE + input->chunk_filled[chunk];
+    input->vectors[chunk] = (struct iovec) { input->file.data + offset,
+                                             chunk_length(input, chunk) - input->chunk_filled[chunk] };
+
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = input->fd;
+    sqe->addr = (uint64_t) (uintptr_t) &input->vectors[chunk];
+    sqe->len = 1;
+    sqe->off = (uint64_t) offset;
+    sqe->user_data = USER_DATA(file, chunk);
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->pending++;
+    loader->in_flight++;
+}
+
+// Submits the queued reads and waits for at least wait_count completions.
+static bool enter_ring(Ring *ring, unsigned wait_count) {
+    for (;;) {
+        long submitted = syscall(__NR_io_uring_enter, ring->fd, ring->pending, wait_count,
+                                 wait_count > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (submitted >= 0) {
+            ring->pending -= (unsigned) submitted;
+            return true;
+        }
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            return false;
+        }
+    }
+}
+
+// Handles the completed reads; an incomplete chunk is queued again for its rest.
+static void reap_completions(Loader *loader) {
+    Ring *ring = &loader->ring;
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        size_t file = USER_DATA_FILE(cqe->user_data);
+        size_t chunk = USER_DATA_CHUNK(cqe->user_data);
+        InputFile *input = &loader->files[file];
+        loader->in_flight--;
+        if (loader->stopping) {
+            continue;
+        }
+        if (cqe->res == -EINTR || cqe->res == -EAGAIN) {
+            queue_read(loader, file, chunk);
+            continue;
+        }
+        record_read(input, chunk, cqe->res);
+        if (!input->failed && !chunk_complete(input, chunk)) {
+            queue_read(loader, file, chunk);
+        }
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+// Keeps the ring full with reads of the next chunks.
+static void issue_reads(Loader *loader) {
+    size_t file;
+    size_t chunk;
+    while (loader->in_flight < loader->ring.entries && next_chunk(loader, &file, &chunk)) {
+        queue_read(loader, file, chunk);
+    }
+}
+#endif
+
+static void *run_reader(void *argument) {
+    Loader *loader = argument;
+    pthread_mutex_lock(&loader->lock);
+    size_t file;
+    size_t chunk;
+    while (!loader->stopping && next_chunk(loader, &file, &chunk)) {
+        InputFile *input = &loader->files[file];
+        pthread_mutex_unlock(&loader->lock);
+
+        // Each chunk is read by one thread only, so its bytes need no lock
+        size_t length = chunk_length(input, chunk);
+        size_t filled = 0;
+        ssize_t result = 1;
+        while (filled < length && result > 0) {
+            result = pread(input->fd, input->file.data + chunk * LOADER_CHUNK_SIZE + filled, length - filled,
+                           (off_t) (chunk * LOADER_CHUNK_SIZE + filled));
+            if (result < 0 && errno == EINTR) {
+                result = 1;
+                continue;
+            }
+            filled += result > 0 ? (size_t) result : 0;
+        }
+
+        pthread_mutex_lock(&loader->lock);
+        record_read(input, chunk, filled == length ? (ssize_t) length : result);
+        loader->completions++;
+        pthread_cond_signal(&loader->progress);
+    }
+    pthread_mutex_unlock(&loader->lock);
+    return NULL;
+}
+
+Loader *start_loading(const char *const *paths, size_t count) {
+    Loader *loader = calloc(1, sizeof(Loader));
+    if (loader == NULL || (loader->files = calloc(count + 1, sizeof(InputFile))) == NULL) {
+        free(loader);
+        return NULL;
+    }
+    loader->count = count;
+    pthread_mutex_init(&loader->lock, NULL);
+    pthread_cond_init(&loader->progress, NULL);
+
+    for (size_t i = 0; i < count; i++) {
+        loader->files[i].failed = !open_input(&loader->files[i], paths[i]);
+        loader->files[i].file.failed = loader->files[i].failed;
+    }
+
+#ifdef HAVE_IO_URING
+    loader->uring = !loader_threads_only && setup_ring(&loader->ring, LOADER_QUEUE_DEPTH);
+    if (loader->uring) {
+        issue_reads(loader);
+        if (enter_ring(&loader->ring, 0)) {
+            return loader;
+        }
+        // Reads the ring refuses are done by the threads instead
+        loader->in_flight = 0;
+        loader->ring.pending = 0;
+        for (size_t i = 0; i < count; i++) {
+            loader->files[i].chunks_issued = 0;
+        }
+        close_ring(&loader->ring);
+        loader->uring = false;
+    }
+#endif
+
+    while (loader->threads_count < LOADER_THREADS
+           && pthread_create(&loader->threads[loader->threads_count], NULL, run_reader, loader) == 0) {
+        loader->threads_count++;
+    }
+    if (loader->threads_count == 0) {
+        // Without threads, the chunks are read by the first wait
+        run_reader(loader);
+    }
+    return loader;
+}
+
+LoadedFile *loaded_file(Loader *loader, size_t index) {
+    return &loader->files[index].file;
+}
+
+// Publishes the chunks read since the last call as arrived, and failures.
+static void update_arrived(Loader *loader) {
+    for (size_t i = 0; i < loader->count; i++) {
+        InputFile *input = &loader->files[i];
+        while (!input->failed && input->chunks_arrived < input->chunks_count
+               && chunk_complete(input, input->chunks_arrived)) {
+            input->chunks_arrived++;
+        }
+        size_t arrived = input->chunks_arrived * LOADER_CHUNK_SIZE;
+        if (input->file.data != NULL && arrived > input->file.arrived) {
+            input->file.arrived = arrived < input->file.size ? arrived : input->file.size;
+        }
+        input->file.failed = input->failed;
+    }
+}
+
+// Whether every file has arrived or failed as far as the caller was told.
+static bool loading_done(const Loader *loader) {
+    for (size_t i = 0; i < loader->count; i++) {
+        const LoadedFile *file = &loader->files[i].file;
+        if (!file->failed && file->arrived < file->size) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool wait_for_loading(Loader *loader) {
+    if (loading_done(loader)) {
+        return false;
+    }
+
+#ifdef HAVE_IO_URING
+    if (loader->uring) {
+        if (enter_ring(&loader->ring, 1)) {
+            reap_completions(loader);
+            issue_reads(loader);
+        } else {
+            for (size_t i = 0; i < loader->count; i++) {
+                loader->files[i].failed |= loader->files[i].chunks_arrived < loader->files[i].chunks_count;
+            }
+        }
+        update_arrived(loader);
+        return true;
+    }
+#endif
+
+    // Until the update every completion is unseen, and unfinished files still have reads pending
+    pthread_mutex_lock(&loader->lock);
+    while (loader->completions == loader->completions_seen) {
+        pthread_cond_wait(&loader->progress, &loader->lock);
+    }
+    loader->completions_seen = loader->completions;
+    update_arrived(loader);
+    pthread_mutex_unlock(&loader->lock);
+    return true;
+}
+
+void finish_loading(Loader *loader) {
+#ifdef HAVE_IO_URING
+    if (loader->uring) {
+        // The kernel may still write to the buffers until the reads complete
+        loader->stopping = true;
+        while (loader->in_flight > 0 && enter_ring(&loader->ring, 1)) {
+            reap_completions(loader);
+        }
+        close_ring(&loader->ring);
+    }
+#endif
+
+    pthread_mutex_lock(&loader->lock);
+    loader->stopping = true;
+    pthread_mutex_unlock(&loader->lock);
+    for (unsigned i = 0; i < loader->threads_count; i++) {
+        pthread_join(loader->threads[i], NULL);
+    }
+
+    for (size_t i = 0; i < loader->count; i++) {
+        if (loader->files[i].fd >= 0) {
+            close(loader->files[i].fd);
+        }
+        free(loader->files[i].chunk_filled);
+        free(loader->files[i].vectors);
+    }
+    pthread_mutex_destroy(&loader->lock);
+    pthread_cond_destroy(&loader->progress);
+    free(loader->files);
+    free(loader);
+}
@@ -0,0 +1,71 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Reads input files into memory by large reads issued for all files at
+ * once, so that the files can be parsed while the rest of them arrives.
+ *
+ * The reads go through io_uring where the kernel provides it, otherwise
+ * through a pool of threads calling pread(). Files that cannot be read at
+ * an offset, such as pipes, are read in one go when loading starts.
+ *
+ * The pool is the one exception to the shared scheduler: every loader starts
+ * LOADER_THREADS threads of its own, so files loaded concurrently run more
+ * readers than the scheduler has workers. The readers block in pread() while
+ * the workers of the scheduler parse and wait for the chunks, so a reader on
+ * the scheduler could be queued behind the very worker waiting for it.
+ */
+
+// Size of one read.
+#define LOADER_CHUNK_SIZE (1024 * 1024)
+
+// Reads in flight at once, over all files.
+#define LOADER_QUEUE_DEPTH 32
+
+// Makes the loaders started afterwards read through the threads even where io_uring works; for tests.
+extern bool loader_threads_only;
+
+typedef struct {
+    char *data;         // Contents of the file followed by '\0', to be released by free()
+    size_t size;
+    size_t arrived;     // Length of the prefix of data already read
+    bool failed;        // The file cannot be opened or read
+} LoadedFile;
+
+typedef struct Loader Loader;
+
+/**
+ * @brief Opens the files and starts reading all of them.
+ *
+ * A file that cannot be opened is marked as failed, the others are read.
+ *
+ * @retval NULL on memory failure.
+ */
+Loader *start_loading(const char *const *paths, size_t count);
+
+/**
+ * @brief Returns the state of the file with the given index.
+ *
+ * The fields change only inside wait_for_loading().
+ */
+LoadedFile *loaded_file(Loader *loader, size_t index);
+
+/**
+ * @brief Waits until more of any file has arrived and updates the arrived
+ * prefixes.
+ *
+ * @retval false without waiting if the last update already left all files
+ * complete or failed.
+ */
+bool wait_for_loading(Loader *loader);
+
+/**
+ * @brief Stops all reads and frees the loader. The data of the files is
+ * not freed; it belongs to the caller.
+ */
+void finish_loading(Loader *loader);
+
+#endif // LOADER_H
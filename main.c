@@ -1,26 +1,105 @@
 #include <stdlib.h>
 #include<stdio.h>
-#include "data_source.h"
+#include <unistd.h>
+#include "dataset.h"
+#include "listing.h"
+#include "stream.h"
 #include "parse_args.h"
+#include "route.h"
+#include "coverage.h"
+#include "batch.h"
+#include "ranking.h"
+#include "server.h"
+#include "scheduler.h"
+#include "edge_sort.h"
 
 int main(int argc, char *argv[])
 {
 
     Filters filters = parse_args(argc, argv);
+
+    // The batch is read first, so that an invalid line does not wait for the data
+    Batch batch = { NULL, 0 };
+    if (filters.batch_path != NULL && !load_batch(&batch, &filters)) {
+        return EXIT_FAILURE;
+    }
     
-    bool ret = init_data_source(filters.containers_path, filters.paths_path);
+    // Without its threads, the parallel stages run sequentially
+    start_scheduler(filters.threads);
+    configure_edge_sort(filters.sort_memory, filters.temp_dir);
+
+    // The plain listing reads the paths only to print the neighbors
+    bool listing = !filters.special_flag && !filters.route_flag && filters.k_paths == 0 && filters.depots == NULL
+                   && !filters.accessibility_flag && filters.top_count == 0;
+    bool needs_paths = listing && (filters.batch_path != NULL ? batch_needs_paths(&batch) : listing_needs_paths(&filters));
+    // A server answers requests for the stations and paths too
+    needs_paths |= filters.serve_path != NULL;
+    // A published snapshot holds the paths and the station graph for any later command
+    needs_paths |= filters.publish_path != NULL;
+    // The station commands read the paths only into the station graph; ranking stations by capacity not at all
+    bool streams_paths = !needs_paths && !listing && filters.top_count == 0;
+    bool ret;
+    if (filters.stream_flag) {
+        // The streamed listing reads the files itself
+        ret = true;
+    } else if (filters.attach_path != NULL) {
+        ret = attach_dataset(filters.attach_path);
+    } else if (streams_paths) {
+        ret = load_graph_dataset(filters.containers_path, filters.paths_path);
+    } else {
+        ret = load_dataset(filters.containers_path, needs_paths ? filters.paths_path : NULL);
+    }
 
     if(ret == false){
+        stop_scheduler();
+        destroy_batch(&batch);
+        destroy_query(filters.query);
+        return EXIT_FAILURE;
+    }
+
+    Writer out;
+    if (!init_writer(&out, STDOUT_FILENO)) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        stop_scheduler();
+        destroy_dataset();
+        destroy_batch(&batch);
+        destroy_query(filters.query);
         return EXIT_FAILURE;
     }
     
     if (filters.special_flag) {
-        print_stations();
+        ret = print_stations(&out, filters);
+    } else if (filters.route_flag) {
+        ret = print_shortest_path(&out, filters.route_from, filters.route_to, filters.route_via);
+    } else if (filters.k_paths > 0) {
+        ret = print_k_shortest_paths(&out, filters.route_from, filters.route_to, filters.k_paths);
+    } else if (filters.depots != NULL) {
+        ret = print_depot_partition(&out, filters.depots);
+    } else if (filters.accessibility_flag) {
+        ret = print_type_accessibility(&out);
+    } else if (filters.top_count > 0) {
+        ret = print_top_stations(&out, filters.top_count, filters.top_type);
+    } else if (filters.publish_path != NULL) {
+        ret = publish_dataset(filters.publish_path);
+    } else if (filters.serve_path != NULL) {
+        ret = serve(filters.serve_path, &filters);
+    } else if (filters.stream_flag) {
+        ret = stream_containers(&out, &filters);
+    } else if (filters.batch_path != NULL) {
+        ret = run_batch(&out, &batch, filters.batch_output, filters.threads);
     } else {
-        print_containers(filters);
+        ret = print_containers(&out, filters);
     }
 
-    destroy_data_source();
+    if (!flush_writer(&out)) {
+        fprintf(stderr, "Writing the output failed.\n");
+        ret = false;
+    }
+    destroy_writer(&out);
+    stop_scheduler();
+    destroy_dataset();
+    destroy_batch(&batch);
+    destroy_query(filters.query);
     
-    return EXIT_SUCCESS;
+    return ret ? EXIT_SUCCESS : EXIT_FAILURE;
 }
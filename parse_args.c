@@ -3,44 +3,369 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <stdint.h>
 #include "parse_args.h"
+#include "dataset.h"
+#include "stations.h"
 
-Filters parse_args(int argc, char *argv[]) {
-    Filters filters = {{"", "", "", "", "", "", "", ""}, 0, 0, 0, 0, NULL, NULL, 0};
+// Options without a short form
+enum {
+    OPTION_K_PATHS = 256,
+    OPTION_FORMAT,
+    OPTION_TOP,
+    OPTION_BY,
+    OPTION_SERVE,
+    OPTION_PUBLISH,
+    OPTION_ATTACH,
+    OPTION_STREAM,
+    OPTION_SORT_MEMORY,
+    OPTION_TEMP_DIR,
+};
+
+static const struct option long_options[] = {
+    {"k-paths", required_argument, NULL, OPTION_K_PATHS},
+    {"format", required_argument, NULL, OPTION_FORMAT},
+    {"top", required_argument, NULL, OPTION_TOP},
+    {"by", required_argument, NULL, OPTION_BY},
+    {"serve", required_argument, NULL, OPTION_SERVE},
+    {"publish", required_argument, NULL, OPTION_PUBLISH},
+    {"attach", required_argument, NULL, OPTION_ATTACH},
+    {"stream", no_argument, NULL, OPTION_STREAM},
+    {"sort-memory", required_argument, NULL, OPTION_SORT_MEMORY},
+    {"temp-dir", required_argument, NULL, OPTION_TEMP_DIR},
+    {NULL, 0, NULL, 0},
+};
+
+// Options of the lines of a batch.
+#define BATCH_OPTIONS "+t:c:p:f:q:a:"
+static const struct option batch_long_options[] = {
+    {NULL, 0, NULL, 0},
+};
+
+// Options of the requests to a server: the listing, -s, -g and --top.
+#define REQUEST_OPTIONS "+t:c:p:f:q:a:sg:v:"
+static const struct option request_long_options[] = {
+    {"format", required_argument, NULL, OPTION_FORMAT},
+    {"top", required_argument, NULL, OPTION_TOP},
+    {"by", required_argument, NULL, OPTION_BY},
+    {NULL, 0, NULL, 0},
+};
+
+// Parses the comma separated list of listing fields, each allowed once.
+static bool parse_fields(const char *list, Filters *filters, FILE *errors) {
+    filters->fields_count = 0;
+    const char *name = list;
+    for (;;) {
+        size_t length = strcspn(name, ",");
+        int field = listing_field_index(name, length);
+        if (field < 0 || memchr(filters->fields, field, filters->fields_count) != NULL) {
+            fprintf(errors, "Invalid value for -f. Use a comma separated list of distinct fields "
+                            "id, type, capacity, address and neighbors.\n");
+            return false;
+        }
+        filters->fields[filters->fields_count++] = (unsigned char) field;
+
+        if (name[length] == '\0') {
+            return true;
+        }
+        name += length + 1;
+    }
+}
+
+// Stores the value of one option in the filters; false with a message for an invalid value.
+static bool parse_option(int opt, const char *arg, Filters *filters, FILE *errors) {
+    char trailing;
+    switch (opt) {
+        case 't':
+            for (size_t i = 0; arg[i] != '\0' && filters->waste_type_count < 8; ++i) {
+                filters->waste_types[filters->waste_type_count][0] = arg[i];
+                filters->waste_types[filters->waste_type_count][1] = '\0';
+                filters->waste_type_count++;
+            }
+            return true;
+        case 'c':
+            if (sscanf(arg, "%d-%d%c", &filters->capacity_min, &filters->capacity_max, &trailing) != 2) {
+                fprintf(errors, "Invalid value for -c. Use min_capacity-max_capacity.\n");
+                return false;
+            }
+            return true;
+        case 'p':
+            if (strcmp(arg, "N") == 0) {
+                filters->public_filter = 0;
+            } else if (strcmp(arg, "Y") == 0) {
+                filters->public_filter = 1;
+            } else {
+                fprintf(errors, "Invalid value for public_filter. Use 'Y' or 'N'.\n");
+                return false;
+            }
+            return true;
+        case 'f':
+            return parse_fields(arg, filters, errors);
+        case 'a':
+            if (strcmp(arg, "type") == 0) {
+                filters->aggregate = AGGREGATE_TYPE;
+            } else if (strcmp(arg, "station") == 0) {
+                filters->aggregate = AGGREGATE_STATION;
+            } else if (strcmp(arg, "street") == 0) {
+                filters->aggregate = AGGREGATE_STREET;
+            } else {
+                fprintf(errors, "Invalid value for -a. Use type, station or street.\n");
+                return false;
+            }
+            return true;
+        case 'q':
+            destroy_query(filters->query);
+            return (filters->query = compile_query(arg, errors)) != NULL;
+        case 's':
+            filters->special_flag = 1;
+            return true;
+        case 'g':
+            if (sscanf(arg, "%zu,%zu%c", &filters->route_from, &filters->route_to, &trailing) != 2) {
+                fprintf(errors, "Invalid value for -g. Use X,Y with station IDs.\n");
+                return false;
+            }
+            filters->route_flag = 1;
+            return true;
+        case 'v':
+            if (strlen(arg) != 1 || (filters->route_via = waste_type_index_of(arg[0])) < 0) {
+                fprintf(errors, "Invalid value for -v. Use one of the waste types %s.\n", WASTE_TYPE_ORDER);
+                return false;
+            }
+            return true;
+        case 'd':
+            if (strspn(arg, "0123456789,") != strlen(arg) || arg[0] == '\0') {
+                fprintf(errors, "Invalid value for -d. Use a comma separated list of station IDs.\n");
+                return false;
+            }
+            filters->depots = arg;
+            return true;
+        case 'n':
+            filters->accessibility_flag = 1;
+            return true;
+        case 'j':
+            // A server gives each of its threads a reader slot of the data
+            if (sscanf(arg, "%u%c", &filters->threads, &trailing) != 1 || filters->threads == 0
+                || filters->threads > DATASET_READERS_MAX) {
+                fprintf(errors, "Invalid value for -j. Use a positive count of threads up to %d.\n",
+                        DATASET_READERS_MAX);
+                return false;
+            }
+            return true;
+        case 'b':
+            filters->batch_path = arg;
+            return true;
+        case 'o':
+            filters->batch_output = arg;
+            return true;
+        case OPTION_K_PATHS:
+            if (sscanf(arg, "%zu,%zu,%zu%c", &filters->route_from, &filters->route_to, &filters->k_paths,
+                       &trailing) != 3 || filters->k_paths == 0) {
+                fprintf(errors, "Invalid value for --k-paths. Use X,Y,K with station IDs and K > 0.\n");
+                return false;
+            }
+            return true;
+        case OPTION_FORMAT:
+            if (strcmp(arg, "text") == 0) {
+                filters->format = FORMAT_TEXT;
+            } else if (strcmp(arg, "ndjson") == 0) {
+                filters->format = FORMAT_NDJSON;
+            } else if (strcmp(arg, "columnar") == 0) {
+                filters->format = FORMAT_COLUMNAR;
+            } else {
+                fprintf(errors, "Invalid value for --format. Use text, ndjson or columnar.\n");
+                return false;
+            }
+            return true;
+        case OPTION_TOP:
+            if (sscanf(arg, "%zu%c", &filters->top_count, &trailing) != 1 || filters->top_count == 0) {
+                fprintf(errors, "Invalid value for --top. Use a positive count of stations.\n");
+                return false;
+            }
+            return true;
+        case OPTION_BY:
+            if (strcmp(arg, "capacity") == 0) {
+                filters->top_type = -1;
+            } else if (strncmp(arg, "capacity:", 9) != 0 || strlen(arg) != 10
+                       || (filters->top_type = waste_type_index_of(arg[9])) < 0) {
+                fprintf(errors, "Invalid value for --by. Use capacity or capacity:TYPE with one of the waste "
+                                "types %s.\n", WASTE_TYPE_ORDER);
+                return false;
+            }
+            return true;
+        case OPTION_SERVE:
+            filters->serve_path = arg;
+            return true;
+        case OPTION_PUBLISH:
+            filters->publish_path = arg;
+            return true;
+        case OPTION_ATTACH:
+            filters->attach_path = arg;
+            return true;
+        case OPTION_STREAM:
+            filters->stream_flag = 1;
+            return true;
+        case OPTION_SORT_MEMORY: {
+            // MiB, or KiB and bytes with the suffix K and B
+            char unit = 'M';
+            int parsed = sscanf(arg, "%zu%c%c", &filters->sort_memory, &unit, &trailing);
+            size_t scale = unit == 'M' ? 1024 * 1024 : unit == 'K' ? 1024 : unit == 'B' ? 1 : 0;
+            if (parsed < 1 || parsed > 2 || scale == 0 || filters->sort_memory == 0
+                || filters->sort_memory > SIZE_MAX / scale) {
+                fprintf(errors, "Invalid value for --sort-memory. Use a positive count of MiB, or of KiB or bytes "
+                                "with the suffix K or B.\n");
+                return false;
+            }
+            filters->sort_memory *= scale;
+            return true;
+        }
+        case OPTION_TEMP_DIR:
+            filters->temp_dir = arg;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Rejects combinations of options that do not work together.
+static bool check_filters(const Filters *filters, bool ranking_given, FILE *errors) {
+    if (filters->special_flag + filters->route_flag + (filters->depots != NULL) + filters->accessibility_flag
+        + (filters->k_paths > 0) + (filters->top_count > 0) > 1) {
+        fprintf(errors, "Options -s, -g, -d, -n, --k-paths and --top cannot be combined\n");
+        return false;
+    }
+    bool listing = !filters->special_flag && !filters->route_flag && filters->depots == NULL
+                   && !filters->accessibility_flag && filters->k_paths == 0 && filters->top_count == 0;
+    // Both run many listings, each with its own filters
+    const char *many = filters->batch_path != NULL ? "-b" : filters->serve_path != NULL ? "--serve" : NULL;
+
+    if (filters->format != FORMAT_TEXT && !listing && !filters->special_flag) {
+        fprintf(errors, "Option --format can be used only with the container listing and -s\n");
+        return false;
+    }
+
+    if (filters->aggregate != AGGREGATE_NONE && !listing) {
+        fprintf(errors, "Option -a can be used only with the container listing\n");
+        return false;
+    }
+
+    if (filters->query != NULL && !listing) {
+        fprintf(errors, "Option -q can be used only with the container listing\n");
+        return false;
+    }
+
+    if (many != NULL && !listing) {
+        fprintf(errors, "Option %s can be used only with the container listing\n", many);
+        return false;
+    }
+
+    if (filters->publish_path != NULL && (!listing || filters->batch_path != NULL || filters->serve_path != NULL
+                                          || filters->attach_path != NULL)) {
+        fprintf(errors, "Option --publish cannot be combined with other modes\n");
+        return false;
+    }
+
+    if (filters->stream_flag && (!listing || many != NULL || filters->publish_path != NULL
+                                 || filters->attach_path != NULL || filters->aggregate != AGGREGATE_NONE
+                                 || filters->format == FORMAT_COLUMNAR)) {
+        fprintf(errors, "Option --stream can be used only with the container listing in text or ndjson\n");
+        return false;
+    }
+
+    if (filters->batch_path != NULL && filters->serve_path != NULL) {
+        fprintf(errors, "Options -b and --serve cannot be combined\n");
+        return false;
+    }
+
+    if (ranking_given && filters->top_count == 0) {
+        fprintf(errors, "Option --by can be used only with --top\n");
+        return false;
+    }
+
+    if (many != NULL && (filters->waste_type_count > 0 || filters->capacity_min != 0 || filters->capacity_max != 0
+                         || filters->public_filter >= 0 || filters->query != NULL)) {
+        fprintf(errors, "Options -t, -c, -p and -q of %s\n",
+                filters->batch_path != NULL ? "a batch belong to its lines" : "a server belong to its requests");
+        return false;
+    }
+
+    if (filters->batch_output != NULL && filters->batch_path == NULL) {
+        fprintf(errors, "Option -o can be used only with -b\n");
+        return false;
+    }
+
+    if (filters->batch_path != NULL && filters->batch_output == NULL && filters->format == FORMAT_COLUMNAR) {
+        fprintf(errors, "Option --format columnar of a batch needs -o\n");
+        return false;
+    }
+
+    if (filters->route_via >= 0 && !filters->route_flag) {
+        fprintf(errors, "Option -v can be used only with -g\n");
+        return false;
+    }
+    return true;
+}
+
+/* Parses the options of argv over the values already in filters. An
+ * unknown option is reported with the usage of the program if given. */
+static bool parse_options(int argc, char *argv[], const char *short_options, const struct option *options,
+                          const char *program, Filters *filters, FILE *errors) {
+    bool ranking_given = false;
     int opt;
 
-    while ((opt = getopt(argc, argv, "t:c:p:s")) != -1) {
-        switch (opt) {
-            case 't':
-                for (size_t i = 0; optarg[i] != '\0' && filters.waste_type_count < 8; ++i) {
-                    filters.waste_types[filters.waste_type_count][0] = optarg[i];
-                    filters.waste_types[filters.waste_type_count][1] = '\0';
-                    filters.waste_type_count++;
-                }
-                break;
-            case 'c':
-                sscanf(optarg, "%d-%d", &filters.capacity_min, &filters.capacity_max);
-                break;
-            case 'p':
-                // Modify support for public filter
-                if (optarg[0] == 'N') {
-                    filters.public_filter = 1;
-                } else if (optarg[0] == 'Y') {
-                    filters.public_filter = -1;
-                } else {
-                    fprintf(stderr, "Invalid value for public_filter. Use 'Y' or 'N'.\n");
-                    exit(EXIT_FAILURE);
-                }
-                break;
-            case 's':
-                filters.special_flag = 1;
-                break;
-            default:
-                fprintf(stderr,
-                        "Usage: %s [-t waste_type] [-c min_capacity-max_capacity] [-p public_filter] containers_file paths_file\n",
-                        argv[0]);
-                exit(EXIT_FAILURE);
+    // Zero makes getopt start over with the new arguments
+    optind = 0;
+    opterr = 0;
+    while ((opt = getopt_long(argc, argv, short_options, options, NULL)) != -1) {
+        if (opt == '?' || opt == ':') {
+            if (optopt != 0 && strchr(short_options, optopt) != NULL) {
+                fprintf(errors, "Option -%c requires a value.\n", optopt);
+            } else if (optopt != 0) {
+                fprintf(errors, "Invalid option -%c.\n", optopt);
+            } else {
+                fprintf(errors, "Invalid option %s.\n", argv[optind - 1]);
+            }
+            if (program != NULL) {
+                fprintf(errors,
+                        "Usage: %s [-t waste_type] [-c min_capacity-max_capacity] [-p public_filter] [-s] [-g X,Y [-v type]] [-d X,Y,...] [-n] [--k-paths X,Y,K] [--top K [--by capacity[:type]]] [-j threads] [-f field,...] [--format text|ndjson|columnar] [-q expression] [-a type|station|street] [-b batch_file [-o directory]] [--serve socket] [--publish snapshot] [--stream] [--sort-memory MiB[K|B]] [--temp-dir directory] containers_file paths_file | --attach snapshot\n",
+                        program);
+            }
+            return false;
+        }
+        if (!parse_option(opt, optarg, filters, errors)) {
+            return false;
+        }
+        ranking_given |= opt == OPTION_BY;
+    }
+    return check_filters(filters, ranking_given, errors);
+}
+
+Filters parse_args(int argc, char *argv[]) {
+    Filters filters = {{"", "", "", "", "", "", "", ""}, 0, 0, 0, -1, NULL, NULL, 0, 0, 0, 0, -1, 0, NULL, 0, 0, {0}, 0, FORMAT_TEXT, NULL, NULL, NULL, AGGREGATE_NONE, 0, -1, NULL, NULL, NULL, 0, 0, NULL};
+
+    if (!parse_options(argc, argv, "t:c:p:sg:v:d:nj:f:q:b:o:a:", long_options, argv[0], &filters, stderr)) {
+        exit(EXIT_FAILURE);
+    }
+
+    if (filters.fields_count == 0) {
+        for (int field = 0; field < LISTING_FIELDS_COUNT; field++) {
+            filters.fields[filters.fields_count++] = (unsigned char) field;
+        }
+    }
+
+    // The parallel stages share a scheduler with a thread per processor unless -j says otherwise
+    if (filters.threads == 0) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        filters.threads = processors > 1 ? (unsigned) processors : 1;
+    }
+
+    // A snapshot replaces the input files
+    if (filters.attach_path != NULL) {
+        if (optind < argc) {
+            fprintf(stderr, "Option --attach replaces containers_file and paths_file\n");
+            exit(EXIT_FAILURE);
         }
+        return filters;
     }
 
     if (optind + 1 >= argc) {
@@ -53,3 +378,84 @@ Filters parse_args(int argc, char *argv[]) {
 
     return filters;
 }
+
+// Splits the line into arguments at whitespace; quotes and backslashes work as in the shell.
+static size_t split_arguments(char *line, char **arguments) {
+    size_t count = 0;
+    char *read = line;
+    while (*read != '\0') {
+        if (isspace((unsigned char) *read)) {
+            read++;
+            continue;
+        }
+
+        char *write = read;
+        arguments[count++] = write;
+        char quote = '\0';
+        while (*read != '\0' && (quote != '\0' || !isspace((unsigned char) *read))) {
+            if (quote == '\0' && (*read == '\'' || *read == '"')) {
+                quote = *read++;
+            } else if (quote != '\0' && *read == quote) {
+                quote = '\0';
+                read++;
+            } else if (*read == '\\' && quote != '\'' && read[1] != '\0') {
+                read++;
+                *write++ = *read++;
+            } else {
+                *write++ = *read++;
+            }
+        }
+        if (*read != '\0') {
+            read++;
+        }
+        *write = '\0';
+    }
+    return count;
+}
+
+/* Parses the options of one line over the listing given by the defaults,
+ * which does not take part in a batch or a server itself. */
+static bool parse_line(char *line, const char *short_options, const struct option *options, const Filters *defaults,
+                       Filters *filters, FILE *errors) {
+    *filters = *defaults;
+    filters->query = NULL;
+    filters->batch_path = NULL;
+    filters->batch_output = NULL;
+    filters->serve_path = NULL;
+    filters->threads = 1;
+
+    // At most one argument per two characters, the program name and the terminating NULL
+    char **argv = malloc((strlen(line) / 2 + 3) * sizeof(char *));
+    if (argv == NULL) {
+        fprintf(errors, "Memory allocation failed.\n");
+        return false;
+    }
+    argv[0] = "";
+    int argc = (int) split_arguments(line, argv + 1) + 1;
+    argv[argc] = NULL;
+
+    bool ok = parse_options(argc, argv, short_options, options, NULL, filters, errors);
+    if (ok && optind < argc) {
+        fprintf(errors, "Unexpected argument '%s'.\n", argv[optind]);
+        ok = false;
+    }
+    free(argv);
+    if (!ok) {
+        destroy_query(filters->query);
+        filters->query = NULL;
+    }
+    return ok;
+}
+
+Filters parse_batch_line(const Filters *defaults, char *line, size_t line_number) {
+    Filters filters;
+    if (!parse_line(line, BATCH_OPTIONS, batch_long_options, defaults, &filters, stderr)) {
+        fprintf(stderr, "Invalid batch line %zu. Use the options -t, -c, -p, -f, -q and -a.\n", line_number);
+        exit(EXIT_FAILURE);
+    }
+    return filters;
+}
+
+bool parse_request(char *line, const Filters *defaults, Filters *filters, FILE *errors) {
+    return parse_line(line, REQUEST_OPTIONS, request_long_options, defaults, filters, errors);
+}
@@ -1,7 +1,31 @@
 #ifndef PARSE_ARGS_H
 #define PARSE_ARGS_H
-#include "data_source.h"
+#include "listing.h"
 
 Filters parse_args(int argc, char *argv[]);
 
+/**
+ * @brief Parses one line of a batch file (-b): options -t, -c, -p, -f, -q and -a
+ * of one container listing, e.g. "-t AP -c 500-2000 -f id".
+ *
+ * Options not given on the line are taken from the defaults. Like
+ * parse_args(), ends the program on an invalid line.
+ *
+ * @param line modified in place while split into arguments.
+ * @param line_number line in the batch file, reported in errors.
+ */
+Filters parse_batch_line(const Filters *defaults, char *line, size_t line_number);
+
+/**
+ * @brief Parses one request to a server (--serve): the options of a container
+ * listing as on a batch line, or -s, -g X,Y [-v type] or --top K [--by ...].
+ *
+ * Options not given in the request are taken from the defaults.
+ *
+ * @param line modified in place while split into arguments.
+ * @param errors stream receiving the reason of an invalid request.
+ * @retval false on an invalid request, nothing to be released in filters.
+ */
+bool parse_request(char *line, const Filters *defaults, Filters *filters, FILE *errors);
+
 #endif /* PARSE_ARGS_H */
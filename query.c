@@ -0,0 +1,915 @@
+#include "query.h"
+#include "dataset.h"
+#include "stations.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Rows tested when estimating how many rows a condition accepts.
+#define SELECTIVITY_SAMPLE 256
+
+// Cost of testing a text condition relative to a column condition.
+#define TEXT_CONDITION_COST 8.0
+
+// Masks accepting every row.
+#define ALL_TYPES_MASK ((uint8_t) (((1u << WASTE_TYPES_COUNT) - 1) | OTHER_TYPE_BIT))
+#define ALL_PUBLIC_MASK ((uint8_t) (NOT_PUBLIC_BIT | PUBLIC_BIT))
+
+// Count of rows returned by evaluate() on memory failure.
+#define EVALUATION_FAILED SIZE_MAX
+
+typedef enum {
+    NODE_TRUE,
+    NODE_FALSE,
+    NODE_AND,
+    NODE_OR,
+    NODE_NOT,
+    NODE_TYPE,
+    NODE_PUBLIC,
+    NODE_CAPACITY,
+    NODE_TEXT
+} NodeKind;
+
+typedef enum {
+    TEXT_ID,
+    TEXT_NAME,
+    TEXT_STREET,
+    TEXT_NUMBER,
+    TEXT_FIELDS_COUNT
+} TextField;
+
+typedef struct Node {
+    NodeKind kind;
+    struct Node **children;     // Operands of AND and OR, the single operand of NOT
+    size_t children_count;
+    uint8_t mask;               // Accepted type_bits or public_bits
+    int32_t min;                // Inclusive capacity range
+    int32_t max;
+    TextField field;
+    bool contains;              // Substring test instead of equality
+    char *text;
+} Node;
+
+struct Query {
+    Node *root;
+};
+
+static const char *const text_fields[TEXT_FIELDS_COUNT] = { "id", "name", "street", "number" };
+
+/* Parsing */
+
+typedef enum {
+    TOKEN_END,
+    TOKEN_WORD,
+    TOKEN_NUMBER,
+    TOKEN_STRING,
+    TOKEN_SYMBOL,
+    TOKEN_INVALID
+} TokenKind;
+
+typedef struct {
+    const char *text;
+    TokenKind kind;
+    const char *start;          // Current token
+    size_t length;
+    bool failed;
+    FILE *errors;
+} Parser;
+
+static void parse_error(Parser *parser, const char *expected) {
+    if (!parser->failed) {
+        fprintf(parser->errors, "Invalid query at position %zu: expected %s.\n",
+                (size_t) (parser->start - parser->text) + 1, expected);
+        parser->failed = true;
+    }
+}
+
+static void memory_error(Parser *parser) {
+    if (!parser->failed) {
+        fprintf(parser->errors, "Memory allocation failed.\n");
+        parser->failed = true;
+    }
+}
+
+static void next_token(Parser *parser) {
+    const char *c = parser->start + parser->length;
+    while (isspace((unsigned char) *c)) {
+        c++;
+    }
+    parser->start = c;
+
+    if (*c == '\0') {
+        parser->kind = TOKEN_END;
+        parser->length = 0;
+    } else if (isalpha((unsigned char) *c) || *c == '_') {
+        parser->kind = TOKEN_WORD;
+        while (isalnum((unsigned char) *c) || *c == '_') {
+            c++;
+        }
+        parser->length = (size_t) (c - parser->start);
+    } else if (isdigit((unsigned char) *c) || (*c == '-' && isdigit((unsigned char) c[1]))) {
+        parser->kind = TOKEN_NUMBER;
+        c++;
+        while (isdigit((unsigned char) *c)) {
+            c++;
+        }
+        parser->length = (size_t) (c - parser->start);
+    } else if (*c == '"') {
+        parser->kind = TOKEN_STRING;
+        c++;
+        while (*c != '"' && *c != '\0') {
+            c += c[0] == '\\' && c[1] != '\0' ? 2 : 1;
+        }
+        if (*c == '\0') {
+            parser->kind = TOKEN_INVALID;
+            parser->length = 0;
+            return;
+        }
+        parser->length = (size_t) (c + 1 - parser->start);
+    } else {
+        parser->kind = TOKEN_SYMBOL;
+        parser->length = (c[1] == '=' && strchr("!<>", *c) != NULL) ? 2 : 1;
+        if (parser->length == 1 && strchr("(),=<>~", *c) == NULL) {
+            parser->kind = TOKEN_INVALID;
+        }
+    }
+}
+
+// Whether the current token is the given word or symbol.
+static bool is_token(const Parser *parser, const char *token) {
+    return (parser->kind == TOKEN_WORD || parser->kind == TOKEN_SYMBOL) && strlen(token) == parser->length
+           && strncmp(parser->start, token, parser->length) == 0;
+}
+
+static bool accept(Parser *parser, const char *token) {
+    if (is_token(parser, token)) {
+        next_token(parser);
+        return true;
+    }
+    return false;
+}
+
+static bool expect(Parser *parser, const char *token) {
+    if (accept(parser, token)) {
+        return true;
+    }
+    char expected[8];
+    snprintf(expected, sizeof(expected), "'%s'", token);
+    parse_error(parser, expected);
+    return false;
+}
+
+static Node *new_node(Parser *parser, NodeKind kind) {
+    Node *node = calloc(1, sizeof(Node));
+    if (node == NULL) {
+        memory_error(parser);
+        return NULL;
+    }
+    node->kind = kind;
+    return node;
+}
+
+static void free_node(Node *node) {
+    if (node == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < node->children_count; i++) {
+        free_node(node->children[i]);
+    }
+    free(node->children);
+    free(node->text);
+    free(node);
+}
+
+// Appends the child, freeing it on memory failure.
+static bool add_child(Node *node, Node *child) {
+    Node **children = realloc(node->children, (node->children_count + 1) * sizeof(Node *));
+    if (children == NULL) {
+        free_node(child);
+        return false;
+    }
+    node->children = children;
+    node->children[node->children_count++] = child;
+    return true;
+}
+
+// Wraps the node into NOT; on failure the node is freed.
+static Node *negate(Parser *parser, Node *node) {
+    Node *not = new_node(parser, NODE_NOT);
+    if (not == NULL || !add_child(not, node)) {
+        free(not);
+        free_node(node);
+        return NULL;
+    }
+    return not;
+}
+
+// Parses a string token without its quotes and escapes.
+static char *parse_string(Parser *parser) {
+    if (parser->kind != TOKEN_STRING) {
+        parse_error(parser, "a string in quotes");
+        return NULL;
+    }
+    char *string = malloc(parser->length);
+    if (string == NULL) {
+        memory_error(parser);
+        return NULL;
+    }
+
+    size_t length = 0;
+    for (const char *c = parser->start + 1; c < parser->start + parser->length - 1; c++) {
+        if (*c == '\\') {
+            c++;
+        }
+        string[length++] = *c;
+    }
+    string[length] = '\0';
+    next_token(parser);
+    return string;
+}
+
+// Parses a waste type letter or full name into its bit.
+static bool parse_type(Parser *parser, uint8_t *bit) {
+    int type = -1;
+    if (parser->kind == TOKEN_WORD && parser->length == 1) {
+        type = waste_type_index_of(parser->start[0]);
+        if (type >= 0) {
+            next_token(parser);
+        }
+    } else if (parser->kind == TOKEN_STRING) {
+        char *name = parse_string(parser);
+        if (name != NULL) {
+            type = waste_type_index_of(get_waste_type_char(name));
+            free(name);
+        }
+    }
+    if (type < 0) {
+        parse_error(parser, "a waste type");
+        return false;
+    }
+    *bit = (uint8_t) (1u << type);
+    return true;
+}
+
+static Node *parse_type_predicate(Parser *parser) {
+    Node *node = new_node(parser, NODE_TYPE);
+    if (node == NULL) {
+        return NULL;
+    }
+
+    bool ok;
+    bool negated = false;
+    if (accept(parser, "in")) {
+        ok = expect(parser, "(");
+        do {
+            uint8_t bit = 0;
+            ok = ok && parse_type(parser, &bit);
+            node->mask |= bit;
+        } while (ok && accept(parser, ","));
+        ok = ok && expect(parser, ")");
+    } else {
+        negated = accept(parser, "!=");
+        ok = negated || accept(parser, "=");
+        if (!ok) {
+            parse_error(parser, "'=', '!=' or 'in'");
+        }
+        ok = ok && parse_type(parser, &node->mask);
+    }
+
+    if (!ok) {
+        free_node(node);
+        return NULL;
+    }
+    return negated ? negate(parser, node) : node;
+}
+
+static Node *parse_capacity_predicate(Parser *parser) {
+    static const char *const operators[] = { "=", "!=", "<", "<=", ">", ">=" };
+    size_t operator = 0;
+    while (operator < sizeof(operators) / sizeof(operators[0]) && !is_token(parser, operators[operator])) {
+        operator++;
+    }
+    if (operator == sizeof(operators) / sizeof(operators[0])) {
+        parse_error(parser, "a comparison");
+        return NULL;
+    }
+    next_token(parser);
+
+    // The bounds are kept off the limits, so "< value" and "> value" do not overflow
+    long value = parser->kind == TOKEN_NUMBER ? strtol(parser->start, NULL, 10) : 0;
+    if (parser->kind != TOKEN_NUMBER || value <= INT32_MIN || value >= INT32_MAX) {
+        parse_error(parser, "a capacity");
+        return NULL;
+    }
+    next_token(parser);
+
+    Node *node = new_node(parser, NODE_CAPACITY);
+    if (node == NULL) {
+        return NULL;
+    }
+    node->min = INT32_MIN;
+    node->max = INT32_MAX;
+    switch (operator) {
+        case 0:
+        case 1:
+            node->min = node->max = (int32_t) value;
+            break;
+        case 2:
+            node->max = (int32_t) (value - 1);
+            break;
+        case 3:
+            node->max = (int32_t) value;
+            break;
+        case 4:
+            node->min = (int32_t) (value + 1);
+            break;
+        case 5:
+            node->min = (int32_t) value;
+            break;
+    }
+    return operator == 1 ? negate(parser, node) : node;
+}
+
+static Node *parse_public_predicate(Parser *parser) {
+    bool negated = accept(parser, "!=");
+    if (!negated && !expect(parser, "=")) {
+        return NULL;
+    }
+    uint8_t mask;
+    if (is_token(parser, "Y")) {
+        mask = PUBLIC_BIT;
+    } else if (is_token(parser, "N")) {
+        mask = NOT_PUBLIC_BIT;
+    } else {
+        parse_error(parser, "Y or N");
+        return NULL;
+    }
+    next_token(parser);
+
+    Node *node = new_node(parser, NODE_PUBLIC);
+    if (node == NULL) {
+        return NULL;
+    }
+    node->mask = negated ? (uint8_t) (ALL_PUBLIC_MASK & ~mask) : mask;
+    return node;
+}
+
+static Node *parse_text_predicate(Parser *parser, TextField field) {
+    bool negated = accept(parser, "!=");
+    bool contains = !negated && accept(parser, "~");
+    if (!negated && !contains && !expect(parser, "=")) {
+        return NULL;
+    }
+    char *text = parse_string(parser);
+    if (text == NULL) {
+        return NULL;
+    }
+
+    Node *node = new_node(parser, NODE_TEXT);
+    if (node == NULL) {
+        free(text);
+        return NULL;
+    }
+    node->field = field;
+    node->contains = contains;
+    node->text = text;
+    return negated ? negate(parser, node) : node;
+}
+
+static Node *parse_expression(Parser *parser);
+
+static Node *parse_factor(Parser *parser) {
+    if (accept(parser, "not")) {
+        Node *operand = parse_factor(parser);
+        return operand == NULL ? NULL : negate(parser, operand);
+    }
+    if (accept(parser, "(")) {
+        Node *node = parse_expression(parser);
+        if (node != NULL && !expect(parser, ")")) {
+            free_node(node);
+            return NULL;
+        }
+        return node;
+    }
+    if (accept(parser, "true")) {
+        return new_node(parser, NODE_TRUE);
+    }
+    if (accept(parser, "false")) {
+        return new_node(parser, NODE_FALSE);
+    }
+    if (accept(parser, "type")) {
+        return parse_type_predicate(parser);
+    }
+    if (accept(parser, "capacity")) {
+        return parse_capacity_predicate(parser);
+    }
+    if (accept(parser, "public")) {
+        return parse_public_predicate(parser);
+    }
+    for (int field = 0; field < TEXT_FIELDS_COUNT; field++) {
+        if (accept(parser, text_fields[field])) {
+            return parse_text_predicate(parser, (TextField) field);
+        }
+    }
+    parse_error(parser, "a condition");
+    return NULL;
+}
+
+// Parses operands joined by the operator into one node of the kind.
+static Node *parse_operands(Parser *parser, const char *operator, NodeKind kind, Node *(*parse_operand)(Parser *)) {
+    Node *first = parse_operand(parser);
+    if (first == NULL || !is_token(parser, operator)) {
+        return first;
+    }
+
+    Node *node = new_node(parser, kind);
+    if (node == NULL || !add_child(node, first)) {
+        free(node);
+        free_node(first);
+        return NULL;
+    }
+    while (accept(parser, operator)) {
+        Node *operand = parse_operand(parser);
+        if (operand == NULL || !add_child(node, operand)) {
+            free_node(node);
+            return NULL;
+        }
+    }
+    return node;
+}
+
+static Node *parse_term(Parser *parser) {
+    return parse_operands(parser, "and", NODE_AND, parse_factor);
+}
+
+static Node *parse_expression(Parser *parser) {
+    return parse_operands(parser, "or", NODE_OR, parse_term);
+}
+
+/* Simplification */
+
+// Turns the node into a constant, dropping its contents.
+static void make_constant(Node *node, bool value) {
+    for (size_t i = 0; i < node->children_count; i++) {
+        free_node(node->children[i]);
+    }
+    free(node->children);
+    free(node->text);
+    memset(node, 0, sizeof(Node));
+    node->kind = value ? NODE_TRUE : NODE_FALSE;
+}
+
+// Replaces the node by its only child.
+static Node *unwrap(Node *node) {
+    Node *child = node->children[0];
+    free(node->children);
+    free(node);
+    return child;
+}
+
+static void simplify_leaf(Node *node) {
+    if ((node->kind == NODE_TYPE && node->mask == 0) || (node->kind == NODE_PUBLIC && node->mask == 0)
+        || (node->kind == NODE_CAPACITY && node->min > node->max)) {
+        make_constant(node, false);
+    } else if ((node->kind == NODE_TYPE && node->mask == ALL_TYPES_MASK)
+               || (node->kind == NODE_PUBLIC && node->mask == ALL_PUBLIC_MASK)
+               || (node->kind == NODE_CAPACITY && node->min == INT32_MIN && node->max == INT32_MAX)) {
+        make_constant(node, true);
+    }
+}
+
+static Node *simplify(Node *node);
+
+// Pushes NOT into column conditions, which have a complement of the same shape.
+static Node *simplify_not(Node *node) {
+    Node *operand = node->children[0] = simplify(node->children[0]);
+    if (operand == NULL) {
+        node->children_count = 0;
+        free_node(node);
+        return NULL;
+    }
+
+    switch (operand->kind) {
+        case NODE_TRUE:
+        case NODE_FALSE:
+            make_constant(node, operand->kind == NODE_FALSE);
+            return node;
+        case NODE_NOT:
+            node->children[0] = unwrap(operand);
+            return unwrap(node);
+        case NODE_TYPE:
+            operand->mask = (uint8_t) (ALL_TYPES_MASK & ~operand->mask);
+            return simplify(unwrap(node));
+        case NODE_PUBLIC:
+            operand->mask = (uint8_t) (ALL_PUBLIC_MASK & ~operand->mask);
+            return simplify(unwrap(node));
+        default:
+            return node;
+    }
+}
+
+// Merges the second column condition of the same kind into the first one.
+static void merge_conditions(Node *into, const Node *from, bool conjunction) {
+    if (into->kind == NODE_CAPACITY) {
+        into->min = into->min > from->min ? into->min : from->min;
+        into->max = into->max < from->max ? into->max : from->max;
+    } else if (conjunction) {
+        into->mask &= from->mask;
+    } else {
+        into->mask |= from->mask;
+    }
+}
+
+/* Flattens nested operators of the same kind, merges the conditions on
+ * types and the public flag (and ranges of capacity under AND) and folds
+ * the constants. */
+static Node *simplify_operator(Node *node) {
+    bool conjunction = node->kind == NODE_AND;
+    Node **operands = NULL;
+    size_t operands_count = 0;
+    Node *merged[NODE_TEXT + 1] = { NULL };
+    bool absorbed = false;
+
+    for (size_t i = 0; i < node->children_count; i++) {
+        Node *child = simplify(node->children[i]);
+        node->children[i] = NULL;
+
+        // Operands of a nested operator of the same kind are taken over
+        Node **children = &child;
+        size_t children_count = 1;
+        bool nested = child != NULL && child->kind == node->kind;
+        if (nested) {
+            children = child->children;
+            children_count = child->children_count;
+        }
+        Node **grown = child == NULL ? NULL : realloc(operands, (operands_count + children_count) * sizeof(Node *));
+        if (grown == NULL) {
+            free_node(child);
+            for (size_t j = 0; j < operands_count; j++) {
+                free_node(operands[j]);
+            }
+            free(operands);
+            free_node(node);    // Frees the operands not simplified yet
+            return NULL;
+        }
+        operands = grown;
+
+        for (size_t j = 0; j < children_count; j++) {
+            Node *operand = children[j];
+            bool mergeable = operand->kind == NODE_TYPE || operand->kind == NODE_PUBLIC
+                             || (conjunction && operand->kind == NODE_CAPACITY);
+            if (operand->kind == (conjunction ? NODE_TRUE : NODE_FALSE)) {
+                free_node(operand);
+            } else if (operand->kind == (conjunction ? NODE_FALSE : NODE_TRUE)) {
+                absorbed = true;
+                free_node(operand);
+            } else if (mergeable && merged[operand->kind] != NULL) {
+                merge_conditions(merged[operand->kind], operand, conjunction);
+                free_node(operand);
+            } else {
+                if (mergeable) {
+                    merged[operand->kind] = operand;
+                }
+                operands[operands_count++] = operand;
+            }
+        }
+        if (nested) {
+            free(child->children);
+            free(child);
+        }
+    }
+
+    free(node->children);
+    node->children = operands;
+    node->children_count = operands_count;
+
+    // Merged conditions may have become constants themselves
+    size_t kept = 0;
+    for (size_t i = 0; i < node->children_count; i++) {
+        Node *operand = node->children[i];
+        simplify_leaf(operand);
+        if (operand->kind == (conjunction ? NODE_TRUE : NODE_FALSE)) {
+            free_node(operand);
+        } else {
+            absorbed |= operand->kind == (conjunction ? NODE_FALSE : NODE_TRUE);
+            node->children[kept++] = operand;
+        }
+    }
+    node->children_count = kept;
+
+    if (absorbed || kept == 0) {
+        make_constant(node, absorbed != conjunction);
+        return node;
+    }
+    return kept == 1 ? unwrap(node) : node;
+}
+
+static Node *simplify(Node *node) {
+    switch (node->kind) {
+        case NODE_NOT:
+            return simplify_not(node);
+        case NODE_AND:
+        case NODE_OR:
+            return simplify_operator(node);
+        default:
+            simplify_leaf(node);
+            return node;
+    }
+}
+
+Query *compile_query(const char *text, FILE *errors) {
+    Parser parser = { text, TOKEN_END, text, 0, false, errors };
+    next_token(&parser);
+
+    Node *root = parse_expression(&parser);
+    if (root != NULL && parser.kind != TOKEN_END) {
+        parse_error(&parser, parser.kind == TOKEN_INVALID ? "a valid token" : "'and', 'or' or the end");
+        free_node(root);
+        return NULL;
+    }
+    if (root == NULL) {
+        return NULL;
+    }
+
+    Query *query = malloc(sizeof(Query));
+    if (query == NULL || (root = simplify(root)) == NULL) {
+        fprintf(errors, "Memory allocation failed.\n");
+        free(query);
+        return NULL;
+    }
+    query->root = root;
+    return query;
+}
+
+void destroy_query(Query *query) {
+    if (query != NULL) {
+        free_node(query->root);
+        free(query);
+    }
+}
+
+/* Evaluation
+ *
+ * Conditions work on sorted lists of rows: a condition keeps the rows it
+ * accepts, AND passes the list through its operands, OR and NOT combine
+ * the results by merging. Rows are never interpreted one by one against
+ * the tree; every leaf runs one of the loops below over the whole list.
+ */
+
+typedef size_t (*Refine)(const Node *node, const ContainerColumns *columns, size_t *rows, size_t count);
+
+// Defines an evaluator keeping the rows for which the condition holds.
+#define DEFINE_REFINE(name, condition)                                                            \
+    static size_t name(const Node *node, const ContainerColumns *columns, size_t *rows, size_t count) { \
+        (void) node;                                                                              \
+        (void) columns;                                                                           \
+        size_t kept = 0;                                                                          \
+        for (size_t k = 0; k < count; k++) {                                                      \
+            size_t row = rows[k];                                                                 \
+            rows[kept] = row;                                                                     \
+            kept += (condition) ? 1 : 0;                                                          \
+        }                                                                                         \
+        return kept;                                                                              \
+    }
+
+// Defines the equality and substring evaluators of a text field.
+#define DEFINE_TEXT_REFINES(field, column)                                                 \
+    DEFINE_REFINE(refine_##field##_equals, strcmp(container_field(row, column), node->text) == 0) \
+    DEFINE_REFINE(refine_##field##_contains, strstr(container_field(row, column), node->text) != NULL)
+
+DEFINE_REFINE(refine_type, columns->type_bits[row] & node->mask)
+DEFINE_REFINE(refine_public, columns->public_bits[row] & node->mask)
+DEFINE_REFINE(refine_capacity, columns->capacity[row] >= node->min && columns->capacity[row] <= node->max)
+DEFINE_TEXT_REFINES(id, CONTAINER_ID)
+DEFINE_TEXT_REFINES(name, CONTAINER_NAME)
+DEFINE_TEXT_REFINES(street, CONTAINER_STREET)
+DEFINE_TEXT_REFINES(number, CONTAINER_NUMBER)
+
+// Indexed by TextField and by contains.
+static const Refine text_refines[TEXT_FIELDS_COUNT][2] = {
+    { refine_id_equals, refine_id_contains },
+    { refine_name_equals, refine_name_contains },
+    { refine_street_equals, refine_street_contains },
+    { refine_number_equals, refine_number_contains },
+};
+
+// Removes the rows of removed, a sorted sublist of rows, from rows.
+static size_t subtract_rows(size_t *rows, size_t count, const size_t *removed, size_t removed_count) {
+    size_t kept = 0;
+    size_t r = 0;
+    for (size_t k = 0; k < count; k++) {
+        if (r < removed_count && removed[r] == rows[k]) {
+            r++;
+        } else {
+            rows[kept++] = rows[k];
+        }
+    }
+    return kept;
+}
+
+// Merges two disjoint sorted lists.
+static size_t merge_rows(const size_t *first, size_t first_count, const size_t *second, size_t second_count,
+                         size_t *merged) {
+    size_t i = 0;
+    size_t j = 0;
+    size_t count = 0;
+    while (i < first_count || j < second_count) {
+        if (j == second_count || (i < first_count && first[i] < second[j])) {
+            merged[count++] = first[i++];
+        } else {
+            merged[count++] = second[j++];
+        }
+    }
+    return count;
+}
+
+static size_t evaluate(const Node *node, const ContainerColumns *columns, size_t *rows, size_t count, bool reorder);
+
+typedef struct {
+    const Node *node;
+    double rank;
+} RankedOperand;
+
+static int compare_ranked(const void *a, const void *b) {
+    double first = ((const RankedOperand *) a)->rank;
+    double second = ((const RankedOperand *) b)->rank;
+    return (first > second) - (first < second);
+}
+
+static double condition_cost(const Node *node) {
+    double cost = node->kind == NODE_TEXT ? TEXT_CONDITION_COST : 1.0;
+    for (size_t i = 0; i < node->children_count; i++) {
+        cost += condition_cost(node->children[i]);
+    }
+    return cost;
+}
+
+/* Orders the operands by the cost per row decided: AND wants the operands
+ * rejecting most rows first, OR the ones accepting most. The accepted
+ * fraction is measured on rows spread over the list. */
+static bool rank_operands(const Node *node, const ContainerColumns *columns, const size_t *rows, size_t count,
+                          RankedOperand *ranked) {
+    size_t sample[SELECTIVITY_SAMPLE];
+    size_t sample_count = count < SELECTIVITY_SAMPLE ? count : SELECTIVITY_SAMPLE;
+    for (size_t i = 0; i < node->children_count; i++) {
+        for (size_t k = 0; k < sample_count; k++) {
+            sample[k] = rows[k * count / sample_count];
+        }
+        size_t accepted = evaluate(node->children[i], columns, sample, sample_count, false);
+        if (accepted == EVALUATION_FAILED) {
+            return false;
+        }
+
+        double fraction = sample_count == 0 ? 0.5 : (double) accepted / (double) sample_count;
+        double decided = node->kind == NODE_AND ? 1.0 - fraction : fraction;
+        ranked[i] = (RankedOperand) { node->children[i], condition_cost(node->children[i]) / (decided + 1e-3) };
+    }
+    qsort(ranked, node->children_count, sizeof(RankedOperand), compare_ranked);
+    return true;
+}
+
+static size_t evaluate_or(const RankedOperand *operands, size_t operands_count, const ContainerColumns *columns,
+                          size_t *rows, size_t count, bool reorder) {
+    size_t *remaining = malloc((count + 1) * sizeof(size_t));
+    size_t *accepted = malloc((count + 1) * sizeof(size_t));
+    size_t *merged = malloc((count + 1) * sizeof(size_t));
+    if (remaining == NULL || accepted == NULL || merged == NULL) {
+        free(remaining);
+        free(accepted);
+        free(merged);
+        return EVALUATION_FAILED;
+    }
+
+    // Each operand only tests the rows no earlier operand accepted
+    memcpy(remaining, rows, count * sizeof(size_t));
+    size_t remaining_count = count;
+    size_t result_count = 0;
+    for (size_t i = 0; i < operands_count && remaining_count > 0; i++) {
+        memcpy(accepted, remaining, remaining_count * sizeof(size_t));
+        size_t accepted_count = evaluate(operands[i].node, columns, accepted, remaining_count, reorder);
+        if (accepted_count == EVALUATION_FAILED) {
+            result_count = EVALUATION_FAILED;
+            break;
+        }
+        remaining_count = subtract_rows(remaining, remaining_count, accepted, accepted_count);
+        result_count = merge_rows(rows, result_count, accepted, accepted_count, merged);
+        memcpy(rows, merged, result_count * sizeof(size_t));
+    }
+
+    free(remaining);
+    free(accepted);
+    free(merged);
+    return result_count;
+}
+
+static size_t evaluate_operator(const Node *node, const ContainerColumns *columns, size_t *rows, size_t count,
+                                bool reorder) {
+    RankedOperand *operands = malloc(node->children_count * sizeof(RankedOperand));
+    if (operands == NULL) {
+        return EVALUATION_FAILED;
+    }
+    for (size_t i = 0; i < node->children_count; i++) {
+        operands[i] = (RankedOperand) { node->children[i], 0.0 };
+    }
+    if (reorder && !rank_operands(node, columns, rows, count, operands)) {
+        free(operands);
+        return EVALUATION_FAILED;
+    }
+
+    if (node->kind == NODE_OR) {
+        count = evaluate_or(operands, node->children_count, columns, rows, count, reorder);
+    } else {
+        for (size_t i = 0; i < node->children_count && count > 0 && count != EVALUATION_FAILED; i++) {
+            count = evaluate(operands[i].node, columns, rows, count, reorder);
+        }
+    }
+    free(operands);
+    return count;
+}
+
+static size_t evaluate(const Node *node, const ContainerColumns *columns, size_t *rows, size_t count, bool reorder) {
+    switch (node->kind) {
+        case NODE_TRUE:
+            return count;
+        case NODE_FALSE:
+            return 0;
+        case NODE_TYPE:
+            return refine_type(node, columns, rows, count);
+        case NODE_PUBLIC:
+            return refine_public(node, columns, rows, count);
+        case NODE_CAPACITY:
+            return refine_capacity(node, columns, rows, count);
+        case NODE_TEXT:
+            return text_refines[node->field][node->contains](node, columns, rows, count);
+        case NODE_AND:
+        case NODE_OR:
+            return evaluate_operator(node, columns, rows, count, reorder);
+        case NODE_NOT: {
+            size_t *accepted = malloc((count + 1) * sizeof(size_t));
+            if (accepted == NULL) {
+                return EVALUATION_FAILED;
+            }
+            memcpy(accepted, rows, count * sizeof(size_t));
+            size_t accepted_count = evaluate(node->children[0], columns, accepted, count, reorder);
+            if (accepted_count != EVALUATION_FAILED) {
+                count = subtract_rows(rows, count, accepted, accepted_count);
+            }
+            free(accepted);
+            return accepted_count == EVALUATION_FAILED ? EVALUATION_FAILED : count;
+        }
+    }
+    return count;
+}
+
+// Moves a column condition into the row filter; false for other nodes.
+static bool fuse_condition(const Node *node, RowFilter *filter) {
+    switch (node->kind) {
+        case NODE_TYPE:
+            filter->type_mask &= node->mask;
+            return true;
+        case NODE_PUBLIC:
+            filter->public_mask &= node->mask;
+            return true;
+        case NODE_CAPACITY:
+            filter->capacity_min = filter->capacity_min > node->min ? filter->capacity_min : node->min;
+            filter->capacity_max = filter->capacity_max < node->max ? filter->capacity_max : node->max;
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool run_query(const Query *query, const RowFilter *filter, const ContainerColumns *columns, size_t *rows,
+               size_t *count) {
+    const Node *root = query->root;
+    RowFilter fused = *filter;
+
+    // The rest of a top-level AND is evaluated as an AND of fewer operands
+    Node rest = { NODE_AND, NULL, 0, 0, 0, 0, TEXT_ID, false, NULL };
+    Node *single[1] = { (Node *) root };
+    Node *const *operands = root->kind == NODE_AND ? root->children : single;
+    size_t operands_count = root->kind == NODE_AND ? root->children_count : 1;
+    Node **rest_operands = malloc(operands_count * sizeof(Node *));
+    if (rest_operands == NULL) {
+        return false;
+    }
+    rest.children = rest_operands;
+    for (size_t i = 0; i < operands_count; i++) {
+        if (!fuse_condition(operands[i], &fused)) {
+            rest.children[rest.children_count++] = operands[i];
+        }
+    }
+
+    *count = filter_rows(columns, &fused, rows);
+    if (rest.children_count == 1) {
+        *count = evaluate(rest.children[0], columns, rows, *count, true);
+    } else if (rest.children_count > 1) {
+        *count = evaluate(&rest, columns, rows, *count, true);
+    }
+    free(rest_operands);
+    return *count != EVALUATION_FAILED;
+}
@@ -0,0 +1,58 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "filter.h"
+
+/*
+ * Filter expressions of the container listing (-q), e.g.
+ *
+ *   type in (A,P) and capacity >= 1000 and street ~ "Drozdi"
+ *
+ * expression := term ("or" term)*
+ * term       := factor ("and" factor)*
+ * factor     := "not" factor | "(" expression ")" | "true" | "false" | predicate
+ * predicate  := "type" ("=" | "!=") TYPE | "type" "in" "(" TYPE ("," TYPE)* ")"
+ *             | "capacity" ("=" | "!=" | "<" | "<=" | ">" | ">=") NUMBER
+ *             | "public" ("=" | "!=") ("Y" | "N")
+ *             | TEXT_FIELD ("=" | "!=" | "~") STRING
+ *
+ * TYPE is a letter of WASTE_TYPE_ORDER or the full name as a string,
+ * TEXT_FIELD one of id, name, street and number, and "~" tests whether the
+ * field contains the string.
+ */
+typedef struct Query Query;
+
+/**
+ * @brief Parses the expression and simplifies it: nested conditions are
+ * flattened, conditions on the same column merged and constants folded.
+ *
+ * @param errors stream receiving the error messages, with the position of
+ * a syntax error in the expression.
+ * @retval Query* the compiled query, to be released by destroy_query().
+ * @retval NULL on a syntax error or memory failure.
+ */
+Query *compile_query(const char *text, FILE *errors);
+
+// Frees the memory allocated for a Query.
+void destroy_query(Query *query);
+
+/**
+ * @brief Selects the rows satisfying both the query and the row filter.
+ *
+ * Type, public flag and capacity conditions joined by "and" at the top
+ * level are merged into the row filter and evaluated by the filter kernel.
+ * The remaining conditions refine its selection in the order of their
+ * estimated selectivity, each by an evaluator specialized for its shape.
+ *
+ * @param filter conditions given by -t, -c and -p.
+ * @param rows receives the accepted rows in ascending order, must hold
+ * columns->count elements.
+ * @retval false on memory failure.
+ */
+bool run_query(const Query *query, const RowFilter *filter, const ContainerColumns *columns, size_t *rows,
+               size_t *count);
+
+#endif // QUERY_H
@@ -0,0 +1,98 @@
+#include "ranking.h"
+#include "dataset.h"
+#include "stations.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+    unsigned long capacity;
+    size_t station;
+} RankedStation;
+
+// Whether a ranks below b: smaller capacity, or the same with a larger station ID.
+static bool ranks_below(const RankedStation *a, const RankedStation *b) {
+    return a->capacity < b->capacity || (a->capacity == b->capacity && a->station > b->station);
+}
+
+// Restores the heap below index i, which keeps the lowest ranked station at the root.
+static void sift_down(RankedStation *heap, size_t count, size_t i) {
+    for (;;) {
+        size_t lowest = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < count && ranks_below(&heap[left], &heap[lowest])) {
+            lowest = left;
+        }
+        if (right < count && ranks_below(&heap[right], &heap[lowest])) {
+            lowest = right;
+        }
+        if (lowest == i) {
+            return;
+        }
+        RankedStation swapped = heap[i];
+        heap[i] = heap[lowest];
+        heap[lowest] = swapped;
+        i = lowest;
+    }
+}
+
+static void sift_up(RankedStation *heap, size_t i) {
+    while (i > 0 && ranks_below(&heap[i], &heap[(i - 1) / 2])) {
+        RankedStation swapped = heap[i];
+        heap[i] = heap[(i - 1) / 2];
+        heap[(i - 1) / 2] = swapped;
+        i = (i - 1) / 2;
+    }
+}
+
+bool print_top_stations(Writer *out, size_t count, int type) {
+    const StationGraph *graph = get_station_graph();
+    size_t limit = graph == NULL || count < graph->stations_count ? count : graph->stations_count;
+    RankedStation *heap = graph == NULL ? NULL : malloc((limit + 1) * sizeof(RankedStation));
+    if (heap == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return false;
+    }
+
+    size_t heap_count = 0;
+    for (size_t s = 0; s < graph->stations_count; s++) {
+        const unsigned long *capacity = &graph->capacity[s * WASTE_TYPES_COUNT];
+        RankedStation station = { 0, s };
+        if (type >= 0) {
+            if (!(graph->waste_mask[s] & (1u << type))) {
+                continue;
+            }
+            station.capacity = capacity[type];
+        } else {
+            for (int t = 0; t < WASTE_TYPES_COUNT; t++) {
+                station.capacity += capacity[t];
+            }
+        }
+
+        if (heap_count < limit) {
+            heap[heap_count] = station;
+            sift_up(heap, heap_count++);
+        } else if (limit > 0 && ranks_below(&heap[0], &station)) {
+            heap[0] = station;
+            sift_down(heap, heap_count, 0);
+        }
+    }
+
+    // Taking the lowest ranked station out of the heap repeatedly leaves them in the order of printing
+    for (size_t end = heap_count; end > 1; end--) {
+        RankedStation lowest = heap[0];
+        heap[0] = heap[end - 1];
+        heap[end - 1] = lowest;
+        sift_down(heap, end - 1, 0);
+    }
+    for (size_t i = 0; i < heap_count; i++) {
+        write_uint(out, heap[i].station + 1);
+        write_char(out, ';');
+        write_uint(out, heap[i].capacity);
+        write_char(out, '\n');
+    }
+
+    free(heap);
+    return !out->failed;
+}
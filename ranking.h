@@ -0,0 +1,22 @@
+#ifndef RANKING_H
+#define RANKING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "writer.h"
+
+/**
+ * @brief Prints the count stations with the largest capacity.
+ *
+ * Prints one line `STATION;CAPACITY` per station, the largest capacity
+ * first and stations of equal capacity by ascending ID. Only the best count
+ * stations are kept while the stations are visited, in a heap, so the
+ * ranking costs O(n log count) and the other stations are never sorted.
+ *
+ * @param type index in WASTE_TYPE_ORDER of the ranked capacity, only stations
+ * offering the type are ranked; -1 ranks the total capacity of all stations.
+ * @retval false on memory failure.
+ */
+bool print_top_stations(Writer *out, size_t count, int type);
+
+#endif // RANKING_H
@@ -0,0 +1,79 @@
+#define _DEFAULT_SOURCE
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "ring.h"
+
+// Polls before the waiting side yields the processor, and before it sleeps.
+#define RING_SPINS 64
+#define RING_YIELDS 64
+
+// Sleep between polls of a side that waits long, in microseconds.
+#define RING_SLEEP 100
+
+bool init_ring(SpscRing *ring, size_t capacity) {
+    size_t slots_count = 1;
+    while (slots_count < capacity) {
+        slots_count *= 2;
+    }
+    ring->slots = malloc(slots_count * sizeof(void *));
+    ring->mask = slots_count - 1;
+    ring->tail = 0;
+    ring->head = 0;
+    ring->closed = false;
+    return ring->slots != NULL;
+}
+
+void destroy_ring(SpscRing *ring) {
+    free(ring->slots);
+    ring->slots = NULL;
+}
+
+// Backs off from polling the other side: spins first, then yields, then sleeps.
+static void back_off(unsigned *polls) {
+    if (*polls < RING_SPINS) {
+        (*polls)++;
+    } else if (*polls < RING_SPINS + RING_YIELDS) {
+        (*polls)++;
+        sched_yield();
+    } else {
+        usleep(RING_SLEEP);
+    }
+}
+
+bool ring_push(SpscRing *ring, void *item) {
+    size_t tail = ring->tail;
+    unsigned polls = 0;
+    while (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) > ring->mask) {
+        if (__atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        back_off(&polls);
+    }
+    if (__atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    ring->slots[tail & ring->mask] = item;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+void *ring_pop(SpscRing *ring) {
+    size_t head = ring->head;
+    unsigned polls = 0;
+    while (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == head) {
+        // Items pushed before the ring was closed are still taken
+        if (__atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE)
+            && __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == head) {
+            return NULL;
+        }
+        back_off(&polls);
+    }
+    void *item = ring->slots[head & ring->mask];
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return item;
+}
+
+void close_ring(SpscRing *ring) {
+    __atomic_store_n(&ring->closed, true, __ATOMIC_RELEASE);
+}
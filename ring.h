@@ -0,0 +1,57 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Lock-free queues of pointers between exactly one producer thread and one
+ * consumer thread. Each side owns one position and only reads the other,
+ * so pushing and popping take no lock and no atomic read-modify-write.
+ */
+
+// Size of a cache line, keeping the positions of the two sides apart.
+#define RING_CACHE_LINE 64
+
+typedef struct {
+    void **slots;
+    size_t mask;                // Capacity - 1, the capacity being a power of two
+    size_t tail;                // Next slot pushed, written by the producer
+    char tail_padding[RING_CACHE_LINE - sizeof(size_t)];
+    size_t head;                // Next slot popped, written by the consumer
+    char head_padding[RING_CACHE_LINE - sizeof(size_t)];
+    bool closed;                // The producer pushes nothing more
+} SpscRing;
+
+/**
+ * @brief Prepares an empty ring.
+ *
+ * @param capacity count of items the ring holds, rounded up to a power of two.
+ * @retval false on memory failure.
+ */
+bool init_ring(SpscRing *ring, size_t capacity);
+
+// Frees the slots; items still in the ring are not freed.
+void destroy_ring(SpscRing *ring);
+
+/**
+ * @brief Adds the item, waiting while the ring is full. Producer only.
+ *
+ * @retval false if the consumer closed the ring and takes nothing more.
+ */
+bool ring_push(SpscRing *ring, void *item);
+
+/**
+ * @brief Takes the oldest item, waiting while the ring is empty. Consumer only.
+ *
+ * @retval NULL once the ring is closed and empty.
+ */
+void *ring_pop(SpscRing *ring);
+
+/**
+ * @brief Ends the stream of the ring. Called by the producer after its last
+ * item, or by the consumer to make the producer stop.
+ */
+void close_ring(SpscRing *ring);
+
+#endif // RING_H
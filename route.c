@@ -0,0 +1,542 @@
+#include "route.h"
+#include "dataset.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// One Dijkstra run; prev and origin are filled only when not NULL.
+typedef struct {
+    const StationGraph *graph;
+    const size_t *sources;
+    size_t sources_count;
+    size_t target;
+    double *dist;
+    size_t *prev;
+    size_t *origin;     // Index into sources of the closest source
+    bool *settled;      // Stations whose distance is final
+} Search;
+
+static void start_search(const Search *search) {
+    for (size_t i = 0; i < search->graph->stations_count; i++) {
+        search->dist[i] = INFINITY;
+        search->settled[i] = false;
+        if (search->prev != NULL) {
+            search->prev[i] = NO_STATION;
+        }
+        if (search->origin != NULL) {
+            search->origin[i] = NO_STATION;
+        }
+    }
+    for (size_t i = 0; i < search->sources_count; i++) {
+        size_t source = search->sources[i];
+        search->dist[source] = 0;
+        if (search->origin != NULL && search->origin[source] == NO_STATION) {
+            search->origin[source] = i;
+        }
+    }
+}
+
+/* Equally distant stations are assigned to the source listed first. Settled
+ * stations are left alone, or a tie over an edge of distance 0 would reopen
+ * them and a station could be expanded more than once. */
+static bool relax(const Search *search, size_t u, size_t e) {
+    size_t v = search->graph->adjacency[e];
+    if (search->settled[v]) {
+        return false;
+    }
+    double alt = search->dist[u] + search->graph->weights[e];
+    if (alt > search->dist[v]
+        || (alt == search->dist[v] && (search->origin == NULL || search->origin[u] >= search->origin[v]))) {
+        return false;
+    }
+
+    search->dist[v] = alt;
+    if (search->prev != NULL) {
+        search->prev[v] = u;
+    }
+    if (search->origin != NULL) {
+        search->origin[v] = search->origin[u];
+    }
+    return true;
+}
+
+typedef struct {
+    double distance;
+    size_t station;
+} HeapItem;
+
+static void heap_push(HeapItem *heap, size_t *size, HeapItem item) {
+    size_t i = (*size)++;
+    while (i > 0 && heap[(i - 1) / 2].distance > item.distance) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = item;
+}
+
+static HeapItem heap_pop(HeapItem *heap, size_t *size) {
+    HeapItem top = heap[0];
+    HeapItem last = heap[--(*size)];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= *size) {
+            break;
+        }
+        if (child + 1 < *size && heap[child + 1].distance < heap[child].distance) {
+            child++;
+        }
+        if (heap[child].distance >= last.distance) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+    return top;
+}
+
+/* Stations may be pushed repeatedly; stale heap items are skipped when popped.
+ * Every station is expanded once, so each edge pushes one item at most. */
+static bool dijkstra(Search *search) {
+    const StationGraph *graph = search->graph;
+    size_t count = graph->stations_count;
+    size_t capacity = graph->adjacency_offsets[count] + search->sources_count + 1;
+    HeapItem *heap = malloc(capacity * sizeof(HeapItem));
+    search->settled = malloc((count > 0 ? count : 1) * sizeof(bool));
+    if (heap == NULL || search->settled == NULL) {
+        free(heap);
+        free(search->settled);
+        return false;
+    }
+
+    start_search(search);
+    size_t size = 0;
+    for (size_t i = 0; i < search->sources_count; i++) {
+        heap_push(heap, &size, (HeapItem) { 0, search->sources[i] });
+    }
+
+    while (size > 0) {
+        HeapItem item = heap_pop(heap, &size);
+        size_t u = item.station;
+        if (search->settled[u] || item.distance > search->dist[u]) {
+            continue;
+        }
+        search->settled[u] = true;
+        if (u == search->target) {
+            break;
+        }
+        for (size_t e = graph->adjacency_offsets[u]; e < graph->adjacency_offsets[u + 1]; e++) {
+            if (relax(search, u, e)) {
+                heap_push(heap, &size, (HeapItem) { search->dist[graph->adjacency[e]], graph->adjacency[e] });
+            }
+        }
+    }
+
+    free(heap);
+    free(search->settled);
+    return true;
+}
+
+bool shortest_paths(const StationGraph *graph, size_t source, size_t target, double *dist, size_t *prev) {
+    Search search = { graph, &source, 1, target, dist, prev, NULL, NULL };
+    return dijkstra(&search);
+}
+
+bool nearest_sources(const StationGraph *graph, const size_t *sources, size_t sources_count, double *dist,
+                     size_t *origin) {
+    Search search = { graph, sources, sources_count, NO_STATION, dist, NULL, origin, NULL };
+    return dijkstra(&search);
+}
+
+/* Builds the graph of states (station, passed) where passed tells whether
+ * a station offering the waste type lies on the way. State (s, 0) has index s
+ * and (s, 1) index s + stations_count; entering a station of the type moves
+ * the walk to the second layer, which it never leaves. */
+static StationGraph *build_layered_graph(const StationGraph *graph, int type) {
+    size_t count = graph->stations_count;
+    size_t edges = graph->adjacency_offsets[count];
+    StationGraph *layered = calloc(1, sizeof(StationGraph));
+    if (layered == NULL) {
+        return NULL;
+    }
+
+    layered->stations_count = 2 * count;
+    layered->adjacency_offsets = malloc((2 * count + 1) * sizeof(size_t));
+    layered->adjacency = malloc((2 * edges + 1) * sizeof(size_t));
+    layered->weights = malloc((2 * edges + 1) * sizeof(double));
+    if (layered->adjacency_offsets == NULL || layered->adjacency == NULL || layered->weights == NULL) {
+        destroy_station_graph(layered);
+        return NULL;
+    }
+
+    size_t e = 0;
+    for (size_t layer = 0; layer < 2; layer++) {
+        for (size_t u = 0; u < count; u++) {
+            layered->adjacency_offsets[layer * count + u] = e;
+            for (size_t i = graph->adjacency_offsets[u]; i < graph->adjacency_offsets[u + 1]; i++) {
+                size_t v = graph->adjacency[i];
+                bool passed = layer == 1 || (graph->waste_mask[v] & (1u << type));
+                layered->adjacency[e] = passed ? v + count : v;
+                layered->weights[e++] = graph->weights[i];
+            }
+        }
+    }
+    layered->adjacency_offsets[2 * count] = e;
+    return layered;
+}
+
+void write_distance(Writer *out, double distance) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.0f", distance);
+    write_string(out, text);
+}
+
+bool print_shortest_path(Writer *out, size_t from_id, size_t to_id, int via_type) {
+    const StationGraph *graph = get_station_graph();
+    if (graph == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return false;
+    }
+
+    if (from_id == 0 || from_id > graph->stations_count || to_id == 0 || to_id > graph->stations_count) {
+        fprintf(stderr, "Station does not exist.\n");
+        return false;
+    }
+
+    size_t stations_count = graph->stations_count;
+    size_t source = from_id - 1;
+    size_t target = to_id - 1;
+    StationGraph *layered = NULL;
+    const StationGraph *search_graph = graph;
+    if (via_type >= 0) {
+        search_graph = layered = build_layered_graph(graph, via_type);
+        if (layered == NULL) {
+            fprintf(stderr, "Memory allocation failed.\n");
+            return false;
+        }
+        if (graph->waste_mask[source] & (1u << via_type)) {
+            source += stations_count;
+        }
+        target += stations_count;
+    }
+
+    size_t count = search_graph->stations_count;
+    double *dist = malloc(count * sizeof(double));
+    size_t *prev = malloc(count * sizeof(size_t));
+    size_t *path = malloc(count * sizeof(size_t));
+    bool ok = dist != NULL && prev != NULL && path != NULL
+              && shortest_paths(search_graph, source, target, dist, prev);
+
+    if (!ok) {
+        fprintf(stderr, "Memory allocation failed.\n");
+    } else if (dist[target] == INFINITY) {
+        write_literal(out, "No path between specified sites\n");
+    } else {
+        size_t length = 0;
+        for (size_t state = target; state != NO_STATION; state = prev[state]) {
+            path[length++] = state % stations_count;
+        }
+        for (size_t i = length; i > 0; i--) {
+            write_uint(out, path[i - 1] + 1);
+            if (i > 1) {
+                write_char(out, '-');
+            }
+        }
+        write_char(out, ' ');
+        write_distance(out, dist[target]);
+        write_char(out, '\n');
+    }
+
+    free(dist);
+    free(prev);
+    free(path);
+    destroy_station_graph(layered);
+    return ok;
+}
+
+#define BITS_PER_WORD (8 * sizeof(unsigned long))
+
+static void set_bit(unsigned long *bits, size_t index) {
+    bits[index / BITS_PER_WORD] |= 1UL << (index % BITS_PER_WORD);
+}
+
+static bool test_bit(const unsigned long *bits, size_t index) {
+    return (bits[index / BITS_PER_WORD] >> (index % BITS_PER_WORD)) & 1UL;
+}
+
+typedef struct {
+    size_t *stations;
+    size_t length;
+    double distance;
+} Route;
+
+/* State shared by all spur searches of Yen's algorithm. The shortest-path
+ * tree towards the target is computed once: its distances are the A*
+ * heuristic of every spur search and, when no banned station or path lies
+ * on the tree route from the spur station, that route is the answer. */
+typedef struct {
+    const StationGraph *graph;
+    size_t target;
+    double *to_target;
+    size_t *next_hop;
+    unsigned long *banned_stations;
+    unsigned long *banned_edges;    // Indexed like graph->adjacency
+    double *dist;
+    size_t *prev;
+    HeapItem *heap;
+} Yen;
+
+// Returns the index of the path from u to v in graph->adjacency.
+static size_t find_edge(const StationGraph *graph, size_t u, size_t v) {
+    size_t low = graph->adjacency_offsets[u];
+    size_t high = graph->adjacency_offsets[u + 1];
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (graph->adjacency[middle] < v) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+// Appends the stations of the found spur path from spur to the target to route.
+static bool tree_spur_path(const Yen *yen, size_t spur, Route *route) {
+    for (size_t u = spur; u != yen->target; u = yen->next_hop[u]) {
+        size_t v = yen->next_hop[u];
+        if (test_bit(yen->banned_stations, v) || test_bit(yen->banned_edges, find_edge(yen->graph, u, v))) {
+            return false;
+        }
+    }
+    for (size_t u = spur; u != NO_STATION; u = yen->next_hop[u]) {
+        route->stations[route->length++] = u;
+    }
+    route->distance += yen->to_target[spur];
+    return true;
+}
+
+static bool searched_spur_path(const Yen *yen, size_t spur, Route *route) {
+    const StationGraph *graph = yen->graph;
+    for (size_t i = 0; i < graph->stations_count; i++) {
+        yen->dist[i] = INFINITY;
+        yen->prev[i] = NO_STATION;
+    }
+
+    size_t size = 0;
+    yen->dist[spur] = 0;
+    heap_push(yen->heap, &size, (HeapItem) { yen->to_target[spur], spur });
+    while (size > 0) {
+        HeapItem item = heap_pop(yen->heap, &size);
+        size_t u = item.station;
+        if (item.distance > yen->dist[u] + yen->to_target[u]) {
+            continue;
+        }
+        if (u == yen->target) {
+            break;
+        }
+        for (size_t e = graph->adjacency_offsets[u]; e < graph->adjacency_offsets[u + 1]; e++) {
+            size_t v = graph->adjacency[e];
+            double alt = yen->dist[u] + graph->weights[e];
+            if (alt < yen->dist[v] && yen->to_target[v] != INFINITY
+                && !test_bit(yen->banned_stations, v) && !test_bit(yen->banned_edges, e)) {
+                yen->dist[v] = alt;
+                yen->prev[v] = u;
+                heap_push(yen->heap, &size, (HeapItem) { alt + yen->to_target[v], v });
+            }
+        }
+    }
+    if (yen->dist[yen->target] == INFINITY) {
+        return false;
+    }
+
+    size_t start = route->length;
+    for (size_t u = yen->target; u != NO_STATION; u = yen->prev[u]) {
+        route->stations[route->length++] = u;
+    }
+    for (size_t i = start, j = route->length - 1; i < j; i++, j--) {
+        size_t swap = route->stations[i];
+        route->stations[i] = route->stations[j];
+        route->stations[j] = swap;
+    }
+    route->distance += yen->dist[yen->target];
+    return true;
+}
+
+static bool same_stations(const Route *a, const Route *b) {
+    return a->length == b->length && memcmp(a->stations, b->stations, a->length * sizeof(size_t)) == 0;
+}
+
+// Orders routes by distance, then by hop count and station IDs.
+static int compare_routes(const Route *a, const Route *b) {
+    if (a->distance != b->distance) return a->distance < b->distance ? -1 : 1;
+    if (a->length != b->length) return a->length < b->length ? -1 : 1;
+    for (size_t i = 0; i < a->length; i++) {
+        if (a->stations[i] != b->stations[i]) return a->stations[i] < b->stations[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+static void print_route(Writer *out, const Route *route) {
+    for (size_t i = 0; i < route->length; i++) {
+        write_uint(out, route->stations[i] + 1);
+        if (i + 1 < route->length) {
+            write_char(out, '-');
+        }
+    }
+    write_char(out, ' ');
+    write_distance(out, route->distance);
+    write_char(out, '\n');
+}
+
+static void free_routes(Route *routes, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(routes[i].stations);
+    }
+    free(routes);
+}
+
+/* Yen's algorithm: the i-th shortest route deviates from one of the shorter
+ * routes at some spur station, reusing its root up to there and avoiding the
+ * continuations already taken by routes with the same root. */
+static bool find_k_routes(Yen *yen, size_t source, size_t k, Route *found, size_t *found_count) {
+    const StationGraph *graph = yen->graph;
+    size_t count = graph->stations_count;
+    size_t edge_words = graph->adjacency_offsets[count] / BITS_PER_WORD + 1;
+    size_t station_words = count / BITS_PER_WORD + 1;
+
+    Route *candidates = NULL;
+    size_t candidates_count = 0;
+    size_t candidates_capacity = 0;
+
+    found[0] = (Route) { malloc(count * sizeof(size_t)), 0, 0 };
+    if (found[0].stations == NULL) {
+        return false;
+    }
+    memset(yen->banned_stations, 0, station_words * sizeof(unsigned long));
+    memset(yen->banned_edges, 0, edge_words * sizeof(unsigned long));
+    tree_spur_path(yen, source, &found[0]);
+    *found_count = 1;
+
+    while (*found_count < k) {
+        const Route *last = &found[*found_count - 1];
+        for (size_t i = 0; i + 1 < last->length; i++) {
+            memset(yen->banned_stations, 0, station_words * sizeof(unsigned long));
+            memset(yen->banned_edges, 0, edge_words * sizeof(unsigned long));
+            for (size_t r = 0; r < *found_count; r++) {
+                const Route *route = &found[r];
+                if (route->length > i + 1 && memcmp(route->stations, last->stations, (i + 1) * sizeof(size_t)) == 0) {
+                    set_bit(yen->banned_edges, find_edge(graph, route->stations[i], route->stations[i + 1]));
+                }
+            }
+            double root_distance = 0;
+            for (size_t j = 0; j < i; j++) {
+                set_bit(yen->banned_stations, last->stations[j]);
+                root_distance += graph->weights[find_edge(graph, last->stations[j], last->stations[j + 1])];
+            }
+
+            if (candidates_count == candidates_capacity) {
+                candidates_capacity = 2 * candidates_capacity + 4;
+                Route *tmp = realloc(candidates, candidates_capacity * sizeof(Route));
+                if (tmp == NULL) {
+                    free_routes(candidates, candidates_count);
+                    return false;
+                }
+                candidates = tmp;
+            }
+            Route candidate = { malloc(count * sizeof(size_t)), i, root_distance };
+            if (candidate.stations == NULL) {
+                free_routes(candidates, candidates_count);
+                return false;
+            }
+            memcpy(candidate.stations, last->stations, i * sizeof(size_t));
+
+            bool spur_found = tree_spur_path(yen, last->stations[i], &candidate)
+                              || searched_spur_path(yen, last->stations[i], &candidate);
+            bool known = !spur_found;
+            for (size_t c = 0; c < candidates_count && !known; c++) {
+                known = same_stations(&candidates[c], &candidate);
+            }
+            if (known) {
+                free(candidate.stations);
+            } else {
+                candidates[candidates_count++] = candidate;
+            }
+        }
+
+        if (candidates_count == 0) {
+            break;
+        }
+        size_t best = 0;
+        for (size_t c = 1; c < candidates_count; c++) {
+            if (compare_routes(&candidates[c], &candidates[best]) < 0) {
+                best = c;
+            }
+        }
+        found[(*found_count)++] = candidates[best];
+        candidates[best] = candidates[--candidates_count];
+    }
+
+    free_routes(candidates, candidates_count);
+    return true;
+}
+
+bool print_k_shortest_paths(Writer *out, size_t from_id, size_t to_id, size_t k) {
+    const StationGraph *graph = get_station_graph();
+    if (graph == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return false;
+    }
+
+    size_t count = graph->stations_count;
+    if (from_id == 0 || from_id > count || to_id == 0 || to_id > count) {
+        fprintf(stderr, "Station does not exist.\n");
+        return false;
+    }
+
+    size_t edges = graph->adjacency_offsets[count];
+    Yen yen = {
+        graph, to_id - 1,
+        malloc((count + 1) * sizeof(double)),
+        malloc((count + 1) * sizeof(size_t)),
+        calloc(count / BITS_PER_WORD + 1, sizeof(unsigned long)),
+        calloc(edges / BITS_PER_WORD + 1, sizeof(unsigned long)),
+        malloc((count + 1) * sizeof(double)),
+        malloc((count + 1) * sizeof(size_t)),
+        malloc((edges + 1) * sizeof(HeapItem)),
+    };
+    Route *found = calloc(k, sizeof(Route));
+    size_t found_count = 0;
+
+    // The graph is symmetric, so predecessors from the target are next hops towards it
+    bool ok = yen.to_target != NULL && yen.next_hop != NULL && yen.banned_stations != NULL
+              && yen.banned_edges != NULL && yen.dist != NULL && yen.prev != NULL && yen.heap != NULL
+              && found != NULL
+              && shortest_paths(graph, yen.target, NO_STATION, yen.to_target, yen.next_hop);
+
+    if (ok && yen.to_target[from_id - 1] == INFINITY) {
+        write_literal(out, "No path between specified sites\n");
+    } else if (ok && (ok = find_k_routes(&yen, from_id - 1, k, found, &found_count))) {
+        for (size_t i = 0; i < found_count; i++) {
+            print_route(out, &found[i]);
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "Memory allocation failed.\n");
+    }
+
+    if (found != NULL) {
+        free_routes(found, found_count);
+    }
+    free(yen.to_target);
+    free(yen.next_hop);
+    free(yen.banned_stations);
+    free(yen.banned_edges);
+    free(yen.dist);
+    free(yen.prev);
+    free(yen.heap);
+    return ok;
+}
@@ -0,0 +1,77 @@
+#ifndef ROUTE_H
+#define ROUTE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "stations.h"
+#include "writer.h"
+
+/**
+ * @brief Runs Dijkstra's algorithm from the source station.
+ *
+ * Fills dist with the distance of every station from the source (INFINITY
+ * if unreachable) and prev with its predecessor on a shortest path
+ * (NO_STATION for the source and unreachable stations). The search stops
+ * once the target is settled; pass NO_STATION to reach all stations.
+ * Only stations settled before the stop have final values.
+ *
+ * The closest unsettled station comes from a binary heap. A linear scan
+ * for it saves at most tens of nanoseconds per search below about 10
+ * stations, with or without SSE2, and loses from there on; see
+ * bench/route_crossover.c.
+ *
+ * @param dist array of graph->stations_count distances.
+ * @param prev array of graph->stations_count predecessors.
+ * @retval false on memory failure.
+ */
+bool shortest_paths(const StationGraph *graph, size_t source, size_t target, double *dist, size_t *prev);
+
+/**
+ * @brief Runs one Dijkstra's algorithm seeded from all the sources at once.
+ *
+ * Fills dist with the distance of every station from its closest source
+ * (INFINITY if unreachable) and origin with the index into sources of that
+ * source (NO_STATION if unreachable). Equally distant stations belong
+ * to the source listed first.
+ *
+ * @param dist array of graph->stations_count distances.
+ * @param origin array of graph->stations_count source indices.
+ * @retval false on memory failure.
+ */
+bool nearest_sources(const StationGraph *graph, const size_t *sources, size_t sources_count, double *dist,
+                     size_t *origin);
+
+// Writes a sum of path distances as a whole number.
+void write_distance(Writer *out, double distance);
+
+/**
+ * @brief Prints the shortest path between two stations in the format
+ * `X-A-B-Y distance`, or `No path between specified sites`.
+ *
+ * With a waste type, the path must pass a station offering it (the start
+ * and target stations count). The constraint is solved by one search over
+ * a two-layer graph instead of one search per candidate station.
+ *
+ * @param from_id ID of the start station (starts from 1).
+ * @param to_id ID of the target station (starts from 1).
+ * @param via_type index of the waste type in WASTE_TYPE_ORDER, or -1.
+ * @retval false if a station does not exist or on memory failure.
+ */
+bool print_shortest_path(Writer *out, size_t from_id, size_t to_id, int via_type);
+
+/**
+ * @brief Prints up to k shortest loopless paths between two stations, one per
+ * line in the format of print_shortest_path() and in increasing length.
+ *
+ * Uses Yen's algorithm. Every spur search runs on the station graph itself,
+ * with banned stations and paths kept in bitmaps, and is guided by one
+ * shortest-path tree towards the target computed up front.
+ *
+ * @param from_id ID of the start station (starts from 1).
+ * @param to_id ID of the target station (starts from 1).
+ * @param k maximal count of printed paths.
+ * @retval false if a station does not exist or on memory failure.
+ */
+bool print_k_shortest_paths(Writer *out, size_t from_id, size_t to_id, size_t k);
+
+#endif // ROUTE_H
@@ -0,0 +1,299 @@
+#define _DEFAULT_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "scheduler.h"
+
+// Polls of an idle thread before it yields the processor, and before it sleeps.
+#define SCHEDULER_SPINS 64
+#define SCHEDULER_YIELDS 64
+
+// Sleep between polls of a thread waiting long for a stolen task, in microseconds.
+#define SCHEDULER_SLEEP 50
+
+typedef struct Task Task;
+
+struct Task {
+    void (*run)(Task *task);
+    int done;                   // Set once run() returned; the task may be gone right after
+};
+
+/* Chase-Lev deque over a fixed circular array. The owner works at the
+ * bottom, thieves take from the top; only the last task is raced for. */
+typedef struct {
+    int64_t top;
+    char top_padding[64 - sizeof(int64_t)];
+    int64_t bottom;
+    char bottom_padding[64 - sizeof(int64_t)];
+    Task *tasks[SCHEDULER_DEQUE_CAPACITY];
+} Deque;
+
+static struct {
+    unsigned threads;           // Deques, one per thread: 0 of the starting thread, then the own threads
+    Deque *deques;
+    pthread_t *workers;
+    int stopping;
+    // Idle threads sleep until a task is pushed
+    pthread_mutex_t lock;
+    pthread_cond_t work_pushed;
+    uint64_t pushes;
+    unsigned sleepers;
+} scheduler = { 1, NULL, NULL, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0 };
+
+// Deque of this thread, NULL for threads outside of the scheduler
+static __thread Deque *own_deque;
+
+// State of the thread's own random choice of victims.
+static __thread unsigned victim_seed;
+
+static bool push_task(Deque *deque, Task *task) {
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    if (bottom - top >= SCHEDULER_DEQUE_CAPACITY) {
+        return false;
+    }
+    __atomic_store_n(&deque->tasks[bottom & (SCHEDULER_DEQUE_CAPACITY - 1)], task, __ATOMIC_RELAXED);
+    // Releases the task to the thieves that acquire the bottom
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELEASE);
+
+    __atomic_add_fetch(&scheduler.pushes, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&scheduler.sleepers, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&scheduler.lock);
+        pthread_cond_signal(&scheduler.work_pushed);
+        pthread_mutex_unlock(&scheduler.lock);
+    }
+    return true;
+}
+
+// Takes the newest task of the own deque.
+static Task *take_task(Deque *deque) {
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+    Task *task = NULL;
+    if (top <= bottom) {
+        task = __atomic_load_n(&deque->tasks[bottom & (SCHEDULER_DEQUE_CAPACITY - 1)], __ATOMIC_RELAXED);
+        if (top == bottom) {
+            // The last task, which a thief may be taking as well
+            if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST,
+                                             __ATOMIC_RELAXED)) {
+                task = NULL;
+            }
+            __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        }
+    } else {
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+    return task;
+}
+
+// Takes the oldest task of another deque; NULL if it is empty or another thief was faster.
+static Task *steal_task(Deque *deque) {
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+    if (top >= bottom) {
+        return NULL;
+    }
+    Task *task = __atomic_load_n(&deque->tasks[top & (SCHEDULER_DEQUE_CAPACITY - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return NULL;
+    }
+    return task;
+}
+
+// Tries the deques of the other threads once each, starting at a random one.
+static Task *steal_any(void) {
+    unsigned count = __atomic_load_n(&scheduler.threads, __ATOMIC_ACQUIRE);
+    unsigned start = (unsigned) rand_r(&victim_seed) % count;
+    for (unsigned k = 0; k < count; k++) {
+        Deque *victim = &scheduler.deques[(start + k) % count];
+        Task *task = victim != own_deque ? steal_task(victim) : NULL;
+        if (task != NULL) {
+            return task;
+        }
+    }
+    return NULL;
+}
+
+static Task *find_task(void) {
+    Task *task = take_task(own_deque);
+    return task != NULL ? task : steal_any();
+}
+
+static void run_task(Task *task) {
+    task->run(task);
+}
+
+// Backs off from polling for work: spins first, then yields, then sleeps if given.
+static void back_off(unsigned *polls) {
+    if (*polls < SCHEDULER_SPINS) {
+        (*polls)++;
+    } else if (*polls < SCHEDULER_SPINS + SCHEDULER_YIELDS) {
+        (*polls)++;
+        sched_yield();
+    } else {
+        usleep(SCHEDULER_SLEEP);
+    }
+}
+
+// Runs other tasks until the task is done, so a thread waiting for a stolen task keeps working.
+static void wait_task(Task *task) {
+    unsigned polls = 0;
+    while (!__atomic_load_n(&task->done, __ATOMIC_ACQUIRE)) {
+        Task *other = find_task();
+        if (other != NULL) {
+            run_task(other);
+            polls = 0;
+        } else {
+            back_off(&polls);
+        }
+    }
+}
+
+static void *run_worker(void *argument) {
+    own_deque = argument;
+    victim_seed = (unsigned) (own_deque - scheduler.deques);
+    unsigned polls = 0;
+    while (!__atomic_load_n(&scheduler.stopping, __ATOMIC_ACQUIRE)) {
+        uint64_t pushes = __atomic_load_n(&scheduler.pushes, __ATOMIC_SEQ_CST);
+        Task *task = find_task();
+        if (task != NULL) {
+            run_task(task);
+            polls = 0;
+            continue;
+        }
+        if (polls < SCHEDULER_SPINS + SCHEDULER_YIELDS) {
+            back_off(&polls);
+            continue;
+        }
+
+        // Nothing pushed since the deques were found empty, so sleep until a push
+        pthread_mutex_lock(&scheduler.lock);
+        __atomic_add_fetch(&scheduler.sleepers, 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&scheduler.pushes, __ATOMIC_SEQ_CST) == pushes
+               && !__atomic_load_n(&scheduler.stopping, __ATOMIC_ACQUIRE)) {
+            pthread_cond_wait(&scheduler.work_pushed, &scheduler.lock);
+        }
+        __atomic_sub_fetch(&scheduler.sleepers, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&scheduler.lock);
+        polls = 0;
+    }
+    return NULL;
+}
+
+bool start_scheduler(unsigned threads) {
+    scheduler.threads = 1;
+    scheduler.stopping = 0;
+    if (threads <= 1) {
+        return true;
+    }
+
+    // Deques are aligned to keep the indices of different threads on their own cache lines
+    void *deques = NULL;
+    scheduler.workers = malloc(threads * sizeof(pthread_t));
+    if (scheduler.workers == NULL || posix_memalign(&deques, 64, threads * sizeof(Deque)) != 0) {
+        free(scheduler.workers);
+        scheduler.workers = NULL;
+        return false;
+    }
+    scheduler.deques = deques;
+    for (unsigned i = 0; i < threads; i++) {
+        scheduler.deques[i].top = 0;
+        scheduler.deques[i].bottom = 0;
+    }
+    own_deque = &scheduler.deques[0];
+    victim_seed = 0;
+
+    // The threads block all signals, so that the process signals reach the threads waiting
+    // for them, e.g. the event loop of the server, which blocks them only later
+    sigset_t all_signals;
+    sigset_t previous_signals;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &previous_signals);
+
+    // Threads started early steal only from the deques counted so far
+    unsigned started = 1;
+    while (started < threads
+           && pthread_create(&scheduler.workers[started - 1], NULL, run_worker, &scheduler.deques[started]) == 0) {
+        started++;
+        __atomic_store_n(&scheduler.threads, started, __ATOMIC_RELEASE);
+    }
+    pthread_sigmask(SIG_SETMASK, &previous_signals, NULL);
+    return true;
+}
+
+void stop_scheduler(void) {
+    pthread_mutex_lock(&scheduler.lock);
+    __atomic_store_n(&scheduler.stopping, 1, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&scheduler.work_pushed);
+    pthread_mutex_unlock(&scheduler.lock);
+    for (unsigned i = 0; i + 1 < scheduler.threads; i++) {
+        pthread_join(scheduler.workers[i], NULL);
+    }
+
+    free(scheduler.workers);
+    free(scheduler.deques);
+    scheduler.workers = NULL;
+    scheduler.deques = NULL;
+    scheduler.threads = 1;
+    own_deque = NULL;
+}
+
+unsigned scheduler_threads(void) {
+    return scheduler.threads;
+}
+
+typedef struct {
+    ParallelBody body;
+    void *context;
+    size_t grain;
+} Loop;
+
+// The upper half of a range, pushed for another thread to steal.
+typedef struct {
+    Task task;
+    const Loop *loop;
+    size_t begin;
+    size_t end;
+} RangeTask;
+
+static void run_range(const Loop *loop, size_t begin, size_t end);
+
+static void run_range_task(Task *task) {
+    RangeTask *range = (RangeTask *) task;
+    run_range(range->loop, range->begin, range->end);
+    __atomic_store_n(&task->done, 1, __ATOMIC_RELEASE);
+}
+
+/* Splits the range until it reaches the grain. The pushed half lives in
+ * this frame, which does not return before the half is done. */
+static void run_range(const Loop *loop, size_t begin, size_t end) {
+    if (end - begin > loop->grain) {
+        size_t middle = begin + (end - begin) / 2;
+        RangeTask upper = { { run_range_task, 0 }, loop, middle, end };
+        if (push_task(own_deque, &upper.task)) {
+            run_range(loop, begin, middle);
+            wait_task(&upper.task);
+            return;
+        }
+    }
+    loop->body(begin, end, loop->context);
+}
+
+void parallel_for(size_t count, size_t grain, ParallelBody body, void *context) {
+    if (count == 0) {
+        return;
+    }
+    Loop loop = { body, context, grain > 0 ? grain : 1 };
+    if (own_deque == NULL || scheduler.threads <= 1) {
+        body(0, count, context);
+        return;
+    }
+    run_range(&loop, 0, count);
+}
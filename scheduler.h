@@ -0,0 +1,57 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Work-stealing scheduler shared by all parallel stages of the program.
+ *
+ * Each thread of the scheduler owns a Chase-Lev deque of tasks: it pushes
+ * and takes tasks at the bottom of its own deque without locking, and once
+ * it runs out of work it steals the oldest task from the top of another
+ * deque. A parallel loop splits its range in halves down to the grain,
+ * pushing one half and working on the other, so idle threads steal the
+ * largest pieces left.
+ *
+ * The thread that starts the scheduler takes part in it. A parallel loop
+ * started by any other thread, such as a server worker, runs sequentially.
+ * The threads of the scheduler block all signals.
+ */
+
+// Tasks a deque holds; a task not fitting is run by its owner right away.
+#define SCHEDULER_DEQUE_CAPACITY 1024
+
+// Runs the body of a parallel loop for the indices from begin up to end - 1.
+typedef void (*ParallelBody)(size_t begin, size_t end, void *context);
+
+/**
+ * @brief Starts the scheduler with the calling thread and threads - 1
+ * threads of its own.
+ *
+ * With fewer threads than asked if they cannot be created; with a single
+ * thread, parallel loops run sequentially.
+ *
+ * @retval false on memory failure, the loops then run sequentially.
+ */
+bool start_scheduler(unsigned threads);
+
+// Stops the threads of the scheduler; no parallel loop may be running.
+void stop_scheduler(void);
+
+// Count of threads of the scheduler, 1 if it is not started.
+unsigned scheduler_threads(void);
+
+/**
+ * @brief Runs the body over the indices from 0 up to count - 1, split into
+ * ranges of at least grain indices run in parallel, and waits for all of
+ * them.
+ *
+ * The body may start parallel loops of its own. Ranges are disjoint and
+ * cover all indices, but run in no particular order.
+ *
+ * @param grain smallest range worth a task of its own, 0 is taken as 1.
+ */
+void parallel_for(size_t count, size_t grain, ParallelBody body, void *context);
+
+#endif // SCHEDULER_H
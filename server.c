@@ -0,0 +1,565 @@
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server.h"
+#include "dataset.h"
+#include "parse_args.h"
+#include "ranking.h"
+#include "route.h"
+#include "writer.h"
+
+// Length prefix of requests and responses, and the status byte of a response.
+#define FRAME_HEADER_SIZE 4
+#define RESPONSE_HEADER_SIZE (FRAME_HEADER_SIZE + 1)
+
+#define STATUS_OK 0
+#define STATUS_ERROR 1
+
+#define EVENTS_PER_WAIT 64
+
+typedef enum {
+    CONNECTION_READING,     // Waiting for the header or the body of a request
+    CONNECTION_ANSWERING,   // Request queued or being rendered by a worker
+    CONNECTION_SENDING      // Response partially sent, waiting until writable
+} ConnectionState;
+
+typedef struct Connection {
+    int fd;
+    ConnectionState state;
+    unsigned char header[FRAME_HEADER_SIZE];
+    size_t header_length;
+    char *request;          // Body of the request, terminated by '\0'
+    size_t request_size;
+    size_t request_length;
+    Filters filters;        // The parsed request while answering
+    Writer response;        // Frame of the response, including its header
+    size_t response_sent;
+    struct Connection *next_job;    // In the job queue or in the finished list
+    struct Connection *prev;        // In the list of all connections
+    struct Connection *next;
+} Connection;
+
+// State shared by the event loop and the workers.
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t jobs_ready;
+    Connection *jobs_head;      // Parsed requests waiting for a worker, oldest first
+    Connection *jobs_tail;
+    Connection *finished;       // Rendered responses waiting for the event loop
+    int finished_event;         // eventfd signalled when a response is finished
+    bool stopping;
+} WorkQueue;
+
+typedef struct {
+    WorkQueue *queue;
+    size_t reader;          // Slot of the worker in enter_dataset()
+    pthread_t thread;
+} Worker;
+
+typedef struct {
+    int epoll_fd;
+    int listen_fd;
+    int signal_fd;
+    Connection *connections;
+    WorkQueue queue;
+    const Filters *defaults;
+    pthread_t reloader;
+    bool reloader_started;
+    bool reloading;         // Set by the event loop, cleared by the reloader when done
+} Server;
+
+static void store_length(unsigned char *bytes, uint32_t length) {
+    bytes[0] = (unsigned char) (length >> 24);
+    bytes[1] = (unsigned char) (length >> 16);
+    bytes[2] = (unsigned char) (length >> 8);
+    bytes[3] = (unsigned char) length;
+}
+
+static uint32_t load_length(const unsigned char *bytes) {
+    return (uint32_t) bytes[0] << 24 | (uint32_t) bytes[1] << 16 | (uint32_t) bytes[2] << 8 | bytes[3];
+}
+
+/* Renders the output of the request from the pinned version of the data.
+ * Returns the status of the response; false in out->failed on memory failure. */
+static int answer_request(Writer *out, const Filters *filters) {
+    bool ok;
+    if (filters->special_flag) {
+        ok = print_stations(out, *filters);
+    } else if (filters->route_flag) {
+        // Checked here, since the count of stations changes with a reload
+        size_t stations_count = get_station_graph()->stations_count;
+        if (filters->route_from == 0 || filters->route_from > stations_count
+            || filters->route_to == 0 || filters->route_to > stations_count) {
+            write_literal(out, "Station does not exist.\n");
+            return STATUS_ERROR;
+        }
+        ok = print_shortest_path(out, filters->route_from, filters->route_to, filters->route_via);
+    } else if (filters->top_count > 0) {
+        ok = print_top_stations(out, filters->top_count, filters->top_type);
+    } else {
+        ok = print_containers(out, *filters);
+    }
+    out->failed |= !ok;
+    return STATUS_OK;
+}
+
+// Fills in the header of a response whose body follows it in the writer.
+static void finish_response(Connection *connection, int status) {
+    Writer *response = &connection->response;
+    if (response->failed) {
+        response->failed = false;
+        response->length = RESPONSE_HEADER_SIZE;
+        write_literal(response, "Memory allocation failed.\n");
+        status = STATUS_ERROR;
+    }
+    store_length((unsigned char *) response->data, (uint32_t) (response->length - RESPONSE_HEADER_SIZE));
+    response->data[FRAME_HEADER_SIZE] = (char) status;
+    connection->response_sent = 0;
+}
+
+static void *run_worker(void *argument) {
+    const Worker *worker = argument;
+    WorkQueue *queue = worker->queue;
+    pthread_mutex_lock(&queue->lock);
+    for (;;) {
+        while (queue->jobs_head == NULL && !queue->stopping) {
+            pthread_cond_wait(&queue->jobs_ready, &queue->lock);
+        }
+        if (queue->stopping) {
+            break;
+        }
+        Connection *connection = queue->jobs_head;
+        queue->jobs_head = connection->next_job;
+        if (queue->jobs_head == NULL) {
+            queue->jobs_tail = NULL;
+        }
+        pthread_mutex_unlock(&queue->lock);
+
+        enter_dataset(worker->reader);
+        int status = answer_request(&connection->response, &connection->filters);
+        leave_dataset(worker->reader);
+        destroy_query(connection->filters.query);
+        connection->filters.query = NULL;
+        finish_response(connection, status);
+
+        pthread_mutex_lock(&queue->lock);
+        connection->next_job = queue->finished;
+        queue->finished = connection;
+        eventfd_write(queue->finished_event, 1);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+static void close_connection(Server *server, Connection *connection) {
+    close(connection->fd);
+    if (connection->prev != NULL) {
+        connection->prev->next = connection->next;
+    } else {
+        server->connections = connection->next;
+    }
+    if (connection->next != NULL) {
+        connection->next->prev = connection->prev;
+    }
+    destroy_query(connection->filters.query);
+    destroy_writer(&connection->response);
+    free(connection->request);
+    free(connection);
+}
+
+// Watches the connection for the events of its state, or for none while answering.
+static bool watch_connection(Server *server, Connection *connection, int operation) {
+    struct epoll_event event = { .events = connection->state == CONNECTION_SENDING ? EPOLLOUT : EPOLLIN,
+                                 .data.ptr = connection };
+    return epoll_ctl(server->epoll_fd, operation, connection->fd, &event) == 0;
+}
+
+static void accept_connections(Server *server) {
+    for (;;) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("accept");
+            }
+            return;
+        }
+
+        Connection *connection = calloc(1, sizeof(Connection));
+        if (fcntl(fd, F_SETFL, O_NONBLOCK) != 0 || connection == NULL) {
+            fprintf(stderr, connection == NULL ? "Memory allocation failed.\n" : "Cannot accept a connection.\n");
+            free(connection);
+            close(fd);
+            continue;
+        }
+        connection->fd = fd;
+        connection->state = CONNECTION_READING;
+        connection->next = server->connections;
+        if (server->connections != NULL) {
+            server->connections->prev = connection;
+        }
+        server->connections = connection;
+        if (!watch_connection(server, connection, EPOLL_CTL_ADD)) {
+            close_connection(server, connection);
+        }
+    }
+}
+
+/* Sends as much of the response as the socket takes. Once all is sent, the
+ * connection reads its next request. Returns false if the client is gone. */
+static bool send_response(Server *server, Connection *connection) {
+    Writer *response = &connection->response;
+    while (connection->response_sent < response->length) {
+        ssize_t sent = send(connection->fd, response->data + connection->response_sent,
+                            response->length - connection->response_sent, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                return false;
+            }
+            if (connection->state != CONNECTION_SENDING) {
+                connection->state = CONNECTION_SENDING;
+                return watch_connection(server, connection, EPOLL_CTL_ADD);
+            }
+            return true;
+        }
+        connection->response_sent += (size_t) sent;
+    }
+
+    int operation = connection->state == CONNECTION_SENDING ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    destroy_writer(response);
+    connection->state = CONNECTION_READING;
+    connection->header_length = 0;
+    connection->request_length = 0;
+    return watch_connection(server, connection, operation);
+}
+
+/* Parses the complete request and queues it for the workers. An invalid
+ * request is answered at once with the reason. */
+static bool dispatch_request(Server *server, Connection *connection) {
+    connection->state = CONNECTION_ANSWERING;
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, connection->fd, NULL) != 0
+        || !init_writer(&connection->response, -1)) {
+        return false;
+    }
+    write_bytes(&connection->response, "\0\0\0\0", RESPONSE_HEADER_SIZE);
+
+    // Parsed here, since getopt keeps its state in globals
+    char *errors_text = NULL;
+    size_t errors_length = 0;
+    FILE *errors = open_memstream(&errors_text, &errors_length);
+    if (errors == NULL) {
+        return false;
+    }
+    bool valid = parse_request(connection->request, server->defaults, &connection->filters, errors);
+    fclose(errors);
+
+    if (!valid) {
+        destroy_query(connection->filters.query);
+        connection->filters.query = NULL;
+        write_bytes(&connection->response, errors_text, errors_length);
+        free(errors_text);
+        finish_response(connection, STATUS_ERROR);
+        return send_response(server, connection);
+    }
+    free(errors_text);
+
+    WorkQueue *queue = &server->queue;
+    pthread_mutex_lock(&queue->lock);
+    connection->next_job = NULL;
+    if (queue->jobs_tail != NULL) {
+        queue->jobs_tail->next_job = connection;
+    } else {
+        queue->jobs_head = connection;
+    }
+    queue->jobs_tail = connection;
+    pthread_cond_signal(&queue->jobs_ready);
+    pthread_mutex_unlock(&queue->lock);
+    return true;
+}
+
+/* Reads the header, then the body of a request, never past its end, so that
+ * the next request stays in the socket. Returns false to close the connection. */
+static bool read_request(Server *server, Connection *connection) {
+    while (connection->state == CONNECTION_READING) {
+        char *target;
+        size_t wanted;
+        if (connection->header_length < FRAME_HEADER_SIZE) {
+            target = (char *) connection->header + connection->header_length;
+            wanted = FRAME_HEADER_SIZE - connection->header_length;
+        } else {
+            uint32_t length = load_length(connection->header);
+            target = connection->request + connection->request_length;
+            wanted = length - connection->request_length;
+        }
+
+        ssize_t received = wanted == 0 ? 0 : recv(connection->fd, target, wanted, 0);
+        if (received < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        if (received == 0 && wanted > 0) {
+            return false;
+        }
+
+        if (connection->header_length < FRAME_HEADER_SIZE) {
+            connection->header_length += (size_t) received;
+            if (connection->header_length < FRAME_HEADER_SIZE) {
+                continue;
+            }
+            uint32_t length = load_length(connection->header);
+            if (length > SERVER_REQUEST_MAX) {
+                return false;
+            }
+            if (length + 1 > connection->request_size) {
+                char *request = realloc(connection->request, length + 1);
+                if (request == NULL) {
+                    fprintf(stderr, "Memory allocation failed.\n");
+                    return false;
+                }
+                connection->request = request;
+                connection->request_size = length + 1;
+            }
+            continue;
+        }
+
+        connection->request_length += (size_t) received;
+        if (connection->request_length == load_length(connection->header)) {
+            connection->request[connection->request_length] = '\0';
+            if (!dispatch_request(server, connection)) {
+                fprintf(stderr, "Memory allocation failed.\n");
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Sends the responses the workers finished since the last call.
+static void send_finished(Server *server) {
+    eventfd_t count;
+    if (eventfd_read(server->queue.finished_event, &count) != 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&server->queue.lock);
+    Connection *finished = server->queue.finished;
+    server->queue.finished = NULL;
+    pthread_mutex_unlock(&server->queue.lock);
+
+    while (finished != NULL) {
+        Connection *connection = finished;
+        finished = connection->next_job;
+        if (!send_response(server, connection)) {
+            close_connection(server, connection);
+        }
+    }
+}
+
+// Binds the listening socket, replacing a stale socket file.
+static int listen_on(const char *socket_path) {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path %s is too long.\n", socket_path);
+        return -1;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    unlink(socket_path);
+    if (bind(fd, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "Cannot listen on %s: %s.\n", socket_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Adds the descriptor to the epoll set, tagged by its field in the server.
+static bool watch_descriptor(Server *server, int *fd) {
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = fd };
+    return epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, *fd, &event) == 0;
+}
+
+static void *run_reload(void *argument) {
+    Server *server = argument;
+    const Filters *defaults = server->defaults;
+    if (defaults->attach_path != NULL) {
+        if (reattach_dataset(defaults->attach_path)) {
+            fprintf(stderr, "Attached %s again.\n", defaults->attach_path);
+        } else {
+            fprintf(stderr, "Attaching failed, the previous data stay.\n");
+        }
+    } else if (reload_dataset(defaults->containers_path, defaults->paths_path)) {
+        fprintf(stderr, "Reloaded %s and %s.\n", defaults->containers_path, defaults->paths_path);
+    } else {
+        fprintf(stderr, "Reloading failed, the previous data stay.\n");
+    }
+    __atomic_store_n(&server->reloading, false, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// Starts loading the input files or the snapshot again in the background, unless a reload is running.
+static void start_reload(Server *server) {
+    if (__atomic_load_n(&server->reloading, __ATOMIC_ACQUIRE)) {
+        fprintf(stderr, "A reload is already running.\n");
+        return;
+    }
+    if (server->reloader_started) {
+        pthread_join(server->reloader, NULL);
+    }
+    server->reloading = true;
+    server->reloader_started = pthread_create(&server->reloader, NULL, run_reload, server) == 0;
+    if (!server->reloader_started) {
+        fprintf(stderr, "Cannot start the reload.\n");
+        server->reloading = false;
+    }
+}
+
+// Runs the event loop until a signal to stop arrives.
+static void run_event_loop(Server *server) {
+    struct epoll_event events[EVENTS_PER_WAIT];
+    for (;;) {
+        int count = epoll_wait(server->epoll_fd, events, EVENTS_PER_WAIT, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            return;
+        }
+
+        for (int i = 0; i < count; i++) {
+            void *tag = events[i].data.ptr;
+            if (tag == &server->signal_fd) {
+                // Taken from the pending signals, so that unblocking them later does not end the program
+                struct signalfd_siginfo signal;
+                if (read(server->signal_fd, &signal, sizeof(signal)) != sizeof(signal)) {
+                    continue;
+                }
+                if (signal.ssi_signo != SIGHUP) {
+                    return;
+                }
+                start_reload(server);
+            } else if (tag == &server->listen_fd) {
+                accept_connections(server);
+            } else if (tag == &server->queue.finished_event) {
+                send_finished(server);
+            } else {
+                Connection *connection = tag;
+                bool alive = connection->state == CONNECTION_SENDING ? send_response(server, connection)
+                                                                     : read_request(server, connection);
+                if (!alive) {
+                    close_connection(server, connection);
+                }
+            }
+        }
+    }
+}
+
+bool serve(const char *socket_path, const Filters *defaults) {
+    // All requests share the indexes and the station graph, built before the first
+    if (!build_container_indexes() || get_station_graph() == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return false;
+    }
+
+    // Signals are taken by the event loop; the workers inherit the mask
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    Server server = { -1, -1, -1, NULL,
+                      { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL, NULL, -1, false },
+                      defaults, 0, false, false };
+    server.listen_fd = listen_on(socket_path);
+    server.signal_fd = signalfd(-1, &signals, SFD_CLOEXEC);
+    server.queue.finished_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    server.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    bool ok = server.listen_fd >= 0 && server.signal_fd >= 0 && server.queue.finished_event >= 0
+              && server.epoll_fd >= 0 && watch_descriptor(&server, &server.listen_fd)
+              && watch_descriptor(&server, &server.signal_fd)
+              && watch_descriptor(&server, &server.queue.finished_event);
+    if (!ok && server.listen_fd >= 0) {
+        perror("Cannot set up the server");
+    }
+
+    // Every worker holds a reader slot of the data source
+    unsigned threads = defaults->threads > 0 ? defaults->threads : 1;
+    if (threads > DATASET_READERS_MAX) {
+        threads = DATASET_READERS_MAX;
+    }
+    Worker *workers = malloc(threads * sizeof(Worker));
+    unsigned started = 0;
+    if (ok && workers == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        ok = false;
+    }
+    while (ok && started < threads) {
+        workers[started] = (Worker) { &server.queue, started, 0 };
+        if (pthread_create(&workers[started].thread, NULL, run_worker, &workers[started]) != 0) {
+            break;
+        }
+        started++;
+    }
+    if (ok && started == 0) {
+        fprintf(stderr, "Cannot start the workers.\n");
+        ok = false;
+    }
+
+    if (ok) {
+        run_event_loop(&server);
+    }
+
+    pthread_mutex_lock(&server.queue.lock);
+    server.queue.stopping = true;
+    pthread_cond_broadcast(&server.queue.jobs_ready);
+    pthread_mutex_unlock(&server.queue.lock);
+    for (unsigned i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    free(workers);
+    if (server.reloader_started) {
+        pthread_join(server.reloader, NULL);
+    }
+
+    while (server.connections != NULL) {
+        close_connection(&server, server.connections);
+    }
+    if (server.listen_fd >= 0) {
+        close(server.listen_fd);
+        unlink(socket_path);
+    }
+    int descriptors[] = { server.signal_fd, server.queue.finished_event, server.epoll_fd };
+    for (size_t i = 0; i < sizeof(descriptors) / sizeof(descriptors[0]); i++) {
+        if (descriptors[i] >= 0) {
+            close(descriptors[i]);
+        }
+    }
+    pthread_mutex_destroy(&server.queue.lock);
+    pthread_cond_destroy(&server.queue.jobs_ready);
+    pthread_sigmask(SIG_UNBLOCK, &signals, NULL);
+    return ok;
+}
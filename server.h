@@ -0,0 +1,44 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+#include "listing.h"
+
+/*
+ * Server answering many queries from one load of the data (--serve).
+ *
+ * Clients connect to a Unix stream socket and send requests, each framed by
+ * its length as a 4-byte big-endian number. A request has the syntax of the
+ * command line options, e.g. "-t AP -c 500-2000 -f id", and is one of
+ *
+ *   a container listing:  -t, -c, -p, -f, -q, -a and --format
+ *   the stations:         -s [--format ...]
+ *   a shortest path:      -g X,Y [-v type]
+ *   a ranking:            --top K [--by capacity[:type]]
+ *
+ * with the defaults given on the command line. Each response is framed by
+ * the length of its body as a 4-byte big-endian number, followed by a status
+ * byte, 0 for the output of the request as its body and 1 for an error
+ * message. A connection may send its next request before the response.
+ */
+
+// Longest request accepted; a longer one closes the connection.
+#define SERVER_REQUEST_MAX (64 * 1024)
+
+/**
+ * @brief Serves the requests until SIGINT or SIGTERM.
+ *
+ * The event loop reads and parses the requests on the calling thread;
+ * defaults->threads workers render the responses. The socket file is
+ * replaced when it exists and removed on exit.
+ *
+ * SIGHUP loads the input files, or attaches the snapshot given by --attach,
+ * again in the background, see reload_dataset(); each request is
+ * answered from one version.
+ *
+ * @param defaults filters of the command line, the defaults of every request.
+ * @retval false if the socket cannot be set up or on memory failure.
+ */
+bool serve(const char *socket_path, const Filters *defaults);
+
+#endif // SERVER_H
@@ -0,0 +1,96 @@
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "snapshot.h"
+
+#define SHARED_MEMORY_PREFIX "shm:"
+
+void *snapshot_array(SnapshotLayout *layout, void *array, size_t size) {
+    size_t offset = (layout->offset + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+    if (layout->mode != SNAPSHOT_MEASURE && (offset > layout->size || size > layout->size - offset)) {
+        layout->failed = true;
+        return NULL;
+    }
+    layout->offset = offset + size;
+
+    switch (layout->mode) {
+        case SNAPSHOT_WRITE:
+            if (size > 0) {
+                memcpy(layout->base + offset, array, size);
+            }
+            return array;
+        case SNAPSHOT_ATTACH:
+            return layout->base + offset;
+        default:
+            return array;
+    }
+}
+
+/* Opens the target with the flags; a shared memory object takes the name
+ * after the prefix, with the leading slash required by shm_open(). */
+static int open_target(const char *target, int flags, bool replace) {
+    if (strncmp(target, SHARED_MEMORY_PREFIX, strlen(SHARED_MEMORY_PREFIX)) != 0) {
+        if (replace) {
+            unlink(target);
+        }
+        return open(target, flags | O_CLOEXEC, 0644);
+    }
+
+    char name[256];
+    if (snprintf(name, sizeof(name), "/%s", target + strlen(SHARED_MEMORY_PREFIX)) >= (int) sizeof(name)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if (replace) {
+        shm_unlink(name);
+    }
+    return shm_open(name, flags, 0644);
+}
+
+char *create_snapshot(const char *target, size_t size) {
+    // A new object, so that the mappings of the old one stay intact
+    int fd = open_target(target, O_RDWR | O_CREAT | O_EXCL, true);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot create the snapshot %s: %s.\n", target, strerror(errno));
+        return NULL;
+    }
+
+    char *base = MAP_FAILED;
+    if (ftruncate(fd, (off_t) size) == 0) {
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Cannot map the snapshot %s: %s.\n", target, strerror(errno));
+    }
+    close(fd);
+    return base == MAP_FAILED ? NULL : base;
+}
+
+char *attach_snapshot(const char *target, size_t *size) {
+    int fd = open_target(target, O_RDONLY, false);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open the snapshot %s: %s.\n", target, strerror(errno));
+        return NULL;
+    }
+
+    struct stat status;
+    char *base = MAP_FAILED;
+    if (fstat(fd, &status) == 0 && status.st_size > 0) {
+        *size = (size_t) status.st_size;
+        base = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Cannot map the snapshot %s.\n", target);
+    }
+    close(fd);
+    return base == MAP_FAILED ? NULL : base;
+}
+
+void detach_snapshot(char *base, size_t size) {
+    munmap(base, size);
+}
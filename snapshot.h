@@ -0,0 +1,69 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Snapshots: arrays laid out one after another in a single block addressed
+ * by offsets, stored in a POSIX shared memory object or a file and mapped
+ * read-only by any number of processes, which then share one copy of the
+ * memory.
+ *
+ * A target "shm:NAME" names the shared memory object /NAME, any other
+ * target is the path of a file.
+ */
+
+// Alignment of every array in a snapshot, also its padding at the end.
+#define SNAPSHOT_ALIGNMENT 64
+
+typedef enum {
+    SNAPSHOT_MEASURE,   // Sums up the sizes of the arrays
+    SNAPSHOT_WRITE,     // Copies the arrays to the snapshot
+    SNAPSHOT_ATTACH     // Finds the arrays in a mapped snapshot
+} SnapshotMode;
+
+/**
+ * @brief Position in a snapshot while its arrays are laid out.
+ *
+ * The same sequence of snapshot_array() calls measures, writes and attaches
+ * a snapshot, so the layout is described once.
+ */
+typedef struct {
+    SnapshotMode mode;
+    char *base;         // The mapped snapshot, NULL while measuring
+    size_t size;        // Size of the mapped snapshot
+    size_t offset;      // Offset of the next array, the total size once measured
+    bool failed;        // An array reached past the end of the snapshot
+} SnapshotLayout;
+
+/**
+ * @brief Lays out the next array of size bytes.
+ *
+ * @retval void* the array in the snapshot when attaching, otherwise the
+ * given one; NULL if it does not fit the snapshot.
+ */
+void *snapshot_array(SnapshotLayout *layout, void *array, size_t size);
+
+/**
+ * @brief Creates the snapshot of the given size, mapped for writing.
+ *
+ * An existing snapshot of the target is replaced; processes attached to it
+ * keep their mapping of the old one.
+ *
+ * @retval NULL if the target cannot be created or mapped, with a message.
+ */
+char *create_snapshot(const char *target, size_t size);
+
+/**
+ * @brief Maps the snapshot of the target read-only.
+ *
+ * @param size receives the size of the snapshot.
+ * @retval NULL if the target cannot be opened or mapped, with a message.
+ */
+char *attach_snapshot(const char *target, size_t *size);
+
+// Unmaps a snapshot created or attached before.
+void detach_snapshot(char *base, size_t size);
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,309 @@
+#include "stations.h"
+#include "dataset.h"
+#include "edge_sort.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Containers closer than this are considered to stand on the same station.
+#define STATION_TOLERANCE 1e-14
+
+typedef struct {
+    double x;
+    double y;
+    size_t row;
+} RowPosition;
+
+typedef struct {
+    unsigned long id;
+    size_t row;
+} RowId;
+
+static int compare_row_positions(const void *a, const void *b) {
+    const RowPosition *first = a;
+    const RowPosition *second = b;
+    if (first->x != second->x) return first->x < second->x ? -1 : 1;
+    if (first->y != second->y) return first->y < second->y ? -1 : 1;
+    if (first->row != second->row) return first->row < second->row ? -1 : 1;
+    return 0;
+}
+
+static int compare_row_ids(const void *a, const void *b) {
+    const RowId *first = a;
+    const RowId *second = b;
+    if (first->id != second->id) return first->id < second->id ? -1 : 1;
+    return 0;
+}
+
+char get_waste_type_char(const char *type){
+    if(strcmp(type, "Plastics and Aluminium")==0)  return 'A';
+    else if(strcmp(type, "Paper")==0) return 'P';
+    else if(strcmp(type, "Biodegradable waste") == 0) return 'B';
+    else if(strcmp(type, "Clear glass") == 0) return 'G';
+    else if(strcmp(type, "Colored glass") == 0) return 'C';
+    else if(strcmp(type, "Textile") == 0) return 'T';
+    else return '\0';
+}
+
+int waste_type_index_of(char type_char) {
+    const char *position = type_char != '\0' ? strchr(WASTE_TYPE_ORDER, type_char) : NULL;
+    return position != NULL ? (int) (position - WASTE_TYPE_ORDER) : -1;
+}
+
+int waste_type_index(const char *type) {
+    return waste_type_index_of(get_waste_type_char(type));
+}
+
+static bool same_position(const RowPosition *a, const RowPosition *b) {
+    double x_diff = a->x - b->x;
+    double y_diff = a->y - b->y;
+    return sqrt(x_diff * x_diff + y_diff * y_diff) < STATION_TOLERANCE;
+}
+
+// Assigns stations to rows, numbered by the first appearance in the file.
+static bool cluster_stations(StationGraph *graph) {
+    size_t count = graph->containers_count;
+    RowPosition *positions = malloc((count + 1) * sizeof(RowPosition));
+    size_t *first_station = malloc((count + 1) * sizeof(size_t));
+    if (positions == NULL || first_station == NULL) {
+        free(positions);
+        free(first_station);
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        positions[i].x = strtod(container_field(i, CONTAINER_X), NULL);
+        positions[i].y = strtod(container_field(i, CONTAINER_Y), NULL);
+        positions[i].row = i;
+    }
+    qsort(positions, count, sizeof(RowPosition), compare_row_positions);
+
+    // Label each row with its group in the sorted order
+    size_t groups_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (i == 0 || !same_position(&positions[i - 1], &positions[i])) {
+            first_station[groups_count++] = NO_STATION;
+        }
+        graph->station_of_row[positions[i].row] = groups_count - 1;
+    }
+    free(positions);
+
+    // Rows are visited in file order, so the first row of a group gets the next ID
+    graph->stations_count = 0;
+    for (size_t row = 0; row < count; row++) {
+        size_t group = graph->station_of_row[row];
+        if (first_station[group] == NO_STATION) {
+            first_station[group] = graph->stations_count++;
+        }
+        graph->station_of_row[row] = first_station[group];
+    }
+    free(first_station);
+    return true;
+}
+
+static bool group_containers(StationGraph *graph) {
+    size_t stations_count = graph->stations_count;
+    graph->x = malloc((stations_count + 1) * sizeof(double));
+    graph->y = malloc((stations_count + 1) * sizeof(double));
+    graph->waste_mask = calloc(stations_count + 1, sizeof(unsigned char));
+    graph->capacity = calloc((stations_count + 1) * WASTE_TYPES_COUNT, sizeof(unsigned long));
+    graph->container_offsets = calloc(stations_count + 2, sizeof(size_t));
+    graph->container_rows = malloc((graph->containers_count + 1) * sizeof(size_t));
+    if (graph->x == NULL || graph->y == NULL || graph->waste_mask == NULL || graph->capacity == NULL
+        || graph->container_offsets == NULL || graph->container_rows == NULL) {
+        return false;
+    }
+
+    for (size_t row = 0; row < graph->containers_count; row++) {
+        size_t station = graph->station_of_row[row];
+        if (graph->container_offsets[station + 1]++ == 0) {
+            graph->x[station] = strtod(container_field(row, CONTAINER_X), NULL);
+            graph->y[station] = strtod(container_field(row, CONTAINER_Y), NULL);
+        }
+        int type = waste_type_index(container_field(row, CONTAINER_WASTE_TYPE));
+        if (type >= 0) {
+            graph->waste_mask[station] |= (unsigned char) (1u << type);
+            graph->capacity[station * WASTE_TYPES_COUNT + type] += strtoul(container_field(row, CONTAINER_CAPACITY), NULL, 10);
+        }
+    }
+    for (size_t s = 0; s < stations_count; s++) {
+        graph->container_offsets[s + 1] += graph->container_offsets[s];
+    }
+
+    size_t *fill = malloc((stations_count + 1) * sizeof(size_t));
+    if (fill == NULL) {
+        return false;
+    }
+    memcpy(fill, graph->container_offsets, stations_count * sizeof(size_t));
+    for (size_t row = 0; row < graph->containers_count; row++) {
+        graph->container_rows[fill[graph->station_of_row[row]]++] = row;
+    }
+    free(fill);
+    return true;
+}
+
+static size_t find_row(const RowId *ids, size_t count, const char *container_id) {
+    RowId key = { strtoul(container_id, NULL, 10), 0 };
+    const RowId *found = bsearch(&key, ids, count, sizeof(RowId), compare_row_ids);
+    return found != NULL ? found->row : NO_STATION;
+}
+
+// The paths being added as edges between stations.
+typedef struct {
+    const StationGraph *graph;
+    const RowId *ids;
+    const char *path;           // Named in the messages
+    EdgeSorter sorter;
+} StationEdges;
+
+// Adds the path on the line as an edge between its stations, both ways.
+static bool add_station_edge(StationEdges *edges, const char *const ids[2], const char *distance_text, size_t line) {
+    size_t rows[2];
+    for (int end = 0; end < 2; end++) {
+        if ((rows[end] = find_row(edges->ids, edges->graph->containers_count, ids[end])) == NO_STATION) {
+            fprintf(stderr, "Unknown container %s on line %zu of %s.\n", ids[end], line, edges->path);
+            return false;
+        }
+    }
+
+    uint32_t station_a = (uint32_t) edges->graph->station_of_row[rows[0]];
+    uint32_t station_b = (uint32_t) edges->graph->station_of_row[rows[1]];
+    if (station_a == station_b) {
+        return true;
+    }
+
+    // Distances are whole meters
+    unsigned long distance = strtoul(distance_text, NULL, 10);
+    EdgeRecord edge = { station_a, station_b, distance < UINT32_MAX ? (uint32_t) distance : UINT32_MAX };
+    return add_edge(&edges->sorter, edge)
+           && add_edge(&edges->sorter, (EdgeRecord) { station_b, station_a, edge.distance });
+}
+
+// Adds the paths of a block of the file.
+static bool add_station_edges(const CsvTable *lines, size_t first_line, void *context) {
+    for (size_t i = 0; i < lines->count; i++) {
+        const char *ids[2] = { csv_field(lines, PATH_COLUMNS_COUNT, i, PATH_A),
+                               csv_field(lines, PATH_COLUMNS_COUNT, i, PATH_B) };
+        if (!add_station_edge(context, ids, csv_field(lines, PATH_COLUMNS_COUNT, i, PATH_DISTANCE),
+                              first_line + i + 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Adds the paths of the loaded data.
+static bool add_loaded_edges(StationEdges *edges) {
+    for (size_t i = 0; i < paths_count(); i++) {
+        const char *ids[2] = { path_field(i, PATH_A), path_field(i, PATH_B) };
+        if (!add_station_edge(edges, ids, path_field(i, PATH_DISTANCE), i + 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Connects the stations by the paths between their containers, those of
+ * the loaded data or those of the file, read in blocks. The edges between
+ * stations are sorted by the external sort, which keeps the shortest of the
+ * duplicate paths and spills to temporary files beyond its memory budget,
+ * and are read back in order into the adjacency; neither the file nor the
+ * edges are held whole. */
+static bool connect_stations(StationGraph *graph, const char *paths_path, bool *reported) {
+    size_t count = graph->containers_count;
+    if (graph->stations_count > UINT32_MAX) {
+        return false;
+    }
+
+    RowId *ids = malloc((count + 1) * sizeof(RowId));
+    graph->adjacency_offsets = calloc(graph->stations_count + 2, sizeof(size_t));
+    if (ids == NULL || graph->adjacency_offsets == NULL) {
+        free(ids);
+        return false;
+    }
+
+    for (size_t row = 0; row < count; row++) {
+        ids[row].id = strtoul(container_field(row, CONTAINER_ID), NULL, 10);
+        ids[row].row = row;
+    }
+    qsort(ids, count, sizeof(RowId), compare_row_ids);
+
+    StationEdges station_edges = { graph, ids, paths_path != NULL ? paths_path : "the loaded paths", { 0 } };
+    init_edge_sorter(&station_edges.sorter);
+    bool streamed = paths_path == NULL
+                    ? add_loaded_edges(&station_edges)
+                    : parse_csv_blocks(paths_path, PATH_COLUMNS_COUNT, add_station_edges, &station_edges);
+    free(ids);
+    // A broken paths file fails silently, as when loaded whole, and the sort reports its failure itself
+    *reported = !streamed || station_edges.sorter.failed;
+
+    EdgeFile edges;
+    EdgeReader reader;
+    if (!finish_edge_sort(&station_edges.sorter, &edges)) {
+        *reported = true;
+        return false;
+    }
+    if (!streamed) {
+        close_edge_file(&edges);
+        return false;
+    }
+    graph->adjacency = malloc((edges.count + 1) * sizeof(size_t));
+    graph->weights = malloc((edges.count + 1) * sizeof(double));
+    if (graph->adjacency == NULL || graph->weights == NULL || !open_edge_reader(&reader, &edges)) {
+        close_edge_file(&edges);
+        return false;
+    }
+
+    EdgeRecord edge;
+    for (size_t i = 0; next_edge(&reader, &edge); i++) {
+        graph->adjacency_offsets[edge.from + 1]++;
+        graph->adjacency[i] = edge.to;
+        graph->weights[i] = edge.distance;
+    }
+    bool ok = !reader.failed;
+    close_edge_reader(&reader);
+    close_edge_file(&edges);
+    for (size_t s = 0; s < graph->stations_count; s++) {
+        graph->adjacency_offsets[s + 1] += graph->adjacency_offsets[s];
+    }
+    return ok;
+}
+
+StationGraph *build_station_graph(const char *paths_path, bool *reported) {
+    *reported = false;
+    StationGraph *graph = calloc(1, sizeof(StationGraph));
+    if (graph == NULL) {
+        return NULL;
+    }
+
+    graph->containers_count = containers_count();
+    graph->station_of_row = malloc((graph->containers_count + 1) * sizeof(size_t));
+    if (graph->station_of_row == NULL
+        || !cluster_stations(graph)
+        || !group_containers(graph)
+        || !connect_stations(graph, paths_path, reported)) {
+        destroy_station_graph(graph);
+        return NULL;
+    }
+
+    return graph;
+}
+
+void destroy_station_graph(StationGraph *graph) {
+    if (graph == NULL) {
+        return;
+    }
+    free(graph->x);
+    free(graph->y);
+    free(graph->waste_mask);
+    free(graph->capacity);
+    free(graph->station_of_row);
+    free(graph->container_offsets);
+    free(graph->container_rows);
+    free(graph->adjacency_offsets);
+    free(graph->adjacency);
+    free(graph->weights);
+    free(graph);
+}
@@ -0,0 +1,71 @@
+#ifndef STATIONS_H
+#define STATIONS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Waste type characters in the order they are printed in the station listing.
+#define WASTE_TYPE_ORDER "APBGCT"
+#define WASTE_TYPES_COUNT 6
+
+// Marks "no station" in station indices, e.g. a missing predecessor.
+#define NO_STATION ((size_t) -1)
+
+/**
+ * @brief Graph of stations built from the loaded data source.
+ *
+ * Stations are indexed from 0 in the order their first container appears
+ * in the containers file, so the printed station ID is index + 1.
+ * Both containers of a station and its neighbors are stored in CSR form:
+ * the neighbors of station s are adjacency[adjacency_offsets[s]] up to
+ * adjacency[adjacency_offsets[s + 1] - 1], sorted ascending, with the length
+ * of the connecting path in weights at the same position.
+ */
+typedef struct {
+    size_t stations_count;
+    double *x;                  // Latitude of the station
+    double *y;                  // Longitude of the station
+    unsigned char *waste_mask;  // Bit i set if WASTE_TYPE_ORDER[i] is present
+    unsigned long *capacity;    // WASTE_TYPES_COUNT total capacities per station
+
+    size_t containers_count;
+    size_t *station_of_row;     // Station index of each container row
+    size_t *container_offsets;
+    size_t *container_rows;     // Container rows grouped by station
+
+    size_t *adjacency_offsets;
+    size_t *adjacency;
+    double *weights;
+} StationGraph;
+
+/**
+ * @brief Clusters the containers of the data source into stations and
+ * connects them by the paths of the data source, or by those of a file,
+ * read in blocks without loading it.
+ *
+ * @warning The data source must be initialized. The returned graph must be
+ * released by destroy_station_graph().
+ *
+ * @param paths_path NULL for the paths of the data source.
+ * @param reported set if the failure needs no further message: an unknown
+ * container of the paths file was reported, the file is broken, which fails
+ * silently as when it is loaded whole, or the sort of the paths reported
+ * its failure.
+ * @retval StationGraph* the built graph.
+ * @retval NULL on memory failure or an invalid paths file.
+ */
+StationGraph *build_station_graph(const char *paths_path, bool *reported);
+
+// Frees the memory allocated for a StationGraph.
+void destroy_station_graph(StationGraph *graph);
+
+// Returns the index of the waste type in WASTE_TYPE_ORDER, or -1 for an unknown type.
+int waste_type_index(const char *type);
+
+// Returns the index of the waste type character in WASTE_TYPE_ORDER, or -1 for an unknown one.
+int waste_type_index_of(char type_char);
+
+// Returns the character of the waste type name, e.g. 'A' for "Plastics and Aluminium", or '\0' for an unknown one.
+char get_waste_type_char(const char *type);
+
+#endif // STATIONS_H
@@ -0,0 +1,344 @@
+#define _DEFAULT_SOURCE
+#include "stream.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "csv.h"
+#include "dataset.h"
+#include "edge_sort.h"
+#include "ring.h"
+
+/*
+ * The streamed listing (--stream) runs as a pipeline of four stages, each
+ * on its own thread and connected to the next by a ring of blocks or
+ * batches: reading the containers file in blocks of whole lines, parsing a
+ * block into a batch, selecting the rows of the batch and rendering them.
+ * A batch is a version of the data of its own rows (dataset.h), pinned by
+ * the thread working on it, so the filters and the rendering of the listing
+ * apply unchanged.
+ *
+ * The paths are not held in memory: a fifth thread reads them in blocks as
+ * well and sorts their edges, both ways, in temporary files (edge_sort.h).
+ * Only a sparse index of the sorted file stays in memory, and the neighbors
+ * of a container are read from the few blocks the index points to. Memory
+ * use is thus bounded by the blocks in flight and the sort budget, whatever
+ * the size of the files. The IDs in the paths file must be numbers, as the
+ * edges are keyed by them; the thread is awaited before the first batch is
+ * rendered.
+ */
+
+// Size a block of the containers file is read in, grown for a longer line.
+#define STREAM_BLOCK_SIZE (1024 * 1024)
+
+// Blocks or batches waiting between two stages.
+#define STREAM_RING_CAPACITY 8
+
+typedef struct {
+    size_t length;
+    size_t capacity;
+    char *data;
+} StreamBlock;
+
+typedef struct {
+    Dataset *data;              // The rows of the batch, the paths shared by all batches
+    size_t *rows;               // Selected rows
+    size_t rows_count;
+} StreamBatch;
+
+typedef struct {
+    const Filters *filters;
+    const char *containers_path;
+    int fd;
+    SpscRing blocks;            // Reader to parser
+    SpscRing parsed;            // Parser to selection
+    SpscRing selected;          // Selection to rendering
+    EdgeFile neighbor_edges;    // Both ends of every path, sorted
+    bool paths_ok;
+    bool failed;                // A stage failed and reported why
+} Stream;
+
+static void fail_stream(Stream *stream, const char *message) {
+    fprintf(stderr, message, stream->containers_path);
+    __atomic_store_n(&stream->failed, true, __ATOMIC_RELEASE);
+}
+
+static void free_block(StreamBlock *block) {
+    free(block->data);
+    free(block);
+}
+
+static StreamBlock *create_block(size_t capacity) {
+    StreamBlock *block = malloc(sizeof(StreamBlock));
+    if (block != NULL && (block->data = malloc(capacity)) == NULL) {
+        free(block);
+        return NULL;
+    }
+    if (block != NULL) {
+        block->length = 0;
+        block->capacity = capacity;
+    }
+    return block;
+}
+
+static void free_batch(StreamBatch *batch) {
+    if (batch->data != NULL) {
+        free_batch_dataset(batch->data);
+    }
+    free(batch->rows);
+    free(batch);
+}
+
+/* Reads blocks ending with a whole line; the rest of the last line starts
+ * the next block. Like the loader, a last line without '\n' is dropped. */
+static void *read_blocks(void *argument) {
+    Stream *stream = argument;
+    StreamBlock *block = create_block(STREAM_BLOCK_SIZE);
+    bool end = false;
+    while (!end) {
+        if (block == NULL) {
+            fail_stream(stream, "Memory allocation failed.\n");
+            break;
+        }
+        ssize_t count = read(stream->fd, block->data + block->length, block->capacity - block->length);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            fail_stream(stream, "Invalid File %s.\n");
+            break;
+        }
+        block->length += (size_t) count;
+        end = count == 0;
+
+        // Whatever a read brings is passed on, so a slow pipe is listed as it comes
+        char *last = block->data + block->length;
+        while (last > block->data && last[-1] != '\n') {
+            last--;
+        }
+        last = last > block->data ? last - 1 : NULL;
+        if (last == NULL && !end && block->length < block->capacity) {
+            continue;
+        }
+        if (last == NULL && !end) {
+            // A line longer than the block
+            char *data = realloc(block->data, block->capacity * 2);
+            if (data == NULL) {
+                fail_stream(stream, "Memory allocation failed.\n");
+                break;
+            }
+            block->data = data;
+            block->capacity *= 2;
+            continue;
+        }
+
+        size_t whole = last != NULL ? (size_t) (last - block->data) + 1 : 0;
+        StreamBlock *next = end ? NULL : create_block(block->capacity);
+        if (next != NULL) {
+            next->length = block->length - whole;
+            memcpy(next->data, block->data + whole, next->length);
+        }
+        block->length = whole;
+        if (whole > 0 && !ring_push(&stream->blocks, block)) {
+            free_block(block);
+            block = next;
+            break;
+        }
+        if (whole == 0) {
+            free_block(block);
+        }
+        block = next;
+    }
+    if (block != NULL) {
+        free_block(block);
+    }
+    close_ring(&stream->blocks);
+    return NULL;
+}
+
+// Parses each block into a batch with its filtered columns.
+static void *parse_blocks(void *argument) {
+    Stream *stream = argument;
+    StreamBlock *block;
+    while ((block = ring_pop(&stream->blocks)) != NULL) {
+        StreamBatch *batch = calloc(1, sizeof(StreamBatch));
+        CsvTable table;
+        CsvParser parser;
+        LoadedFile lines = { block->data, block->length, block->length, false };
+        bool ok = batch != NULL && start_csv(&parser, &table, CONTAINER_COLUMNS_COUNT);
+        bool valid = ok && parse_csv_lines(&parser, &lines);
+        if (ok && !valid) {
+            free_csv_table(&table);
+        }
+        ok = ok && valid && (batch->data = create_batch_dataset(&table)) != NULL;
+        free_block(block);
+        if (!ok) {
+            fail_stream(stream, valid ? "Memory allocation failed.\n" : "Invalid File %s.\n");
+        }
+        if (!ok || !ring_push(&stream->parsed, batch)) {
+            if (batch != NULL) {
+                free_batch(batch);
+            }
+            close_ring(&stream->blocks);
+            break;
+        }
+    }
+    close_ring(&stream->parsed);
+    return NULL;
+}
+
+// Selects the rows of each batch by the filters and the query, on the columns of the batch.
+static void *select_batches(void *argument) {
+    Stream *stream = argument;
+    RowFilter filter = row_filter(stream->filters);
+    StreamBatch *batch;
+    while ((batch = ring_pop(&stream->parsed)) != NULL) {
+        // Pinned, so that the text conditions of the query read the fields of the batch
+        pin_batch_dataset(batch->data);
+        batch->rows = malloc((containers_count() + 1) * sizeof(size_t));
+        bool ok = batch->rows != NULL;
+        if (ok && stream->filters->query != NULL) {
+            ok = run_query(stream->filters->query, &filter, container_columns(), batch->rows, &batch->rows_count);
+        } else if (ok) {
+            batch->rows_count = filter_rows(container_columns(), &filter, batch->rows);
+        }
+        pin_batch_dataset(NULL);
+        if (!ok) {
+            fail_stream(stream, "Memory allocation failed.\n");
+        }
+        if (!ok || !ring_push(&stream->selected, batch)) {
+            free_batch(batch);
+            close_ring(&stream->parsed);
+            break;
+        }
+    }
+    close_ring(&stream->selected);
+    return NULL;
+}
+
+// The paths file being sorted by spill_paths().
+typedef struct {
+    const char *path;
+    EdgeSorter *sorter;
+} PathEdges;
+
+// Adds both ends of the parsed paths as edges; false with a message for an ID that is not numeric.
+static bool add_path_edges(const CsvTable *table, size_t first_line, void *context) {
+    const char *path = ((PathEdges *) context)->path;
+    EdgeSorter *sorter = ((PathEdges *) context)->sorter;
+    for (size_t i = 0; i < table->count; i++) {
+        const char *a = csv_field(table, PATH_COLUMNS_COUNT, i, PATH_A);
+        const char *b = csv_field(table, PATH_COLUMNS_COUNT, i, PATH_B);
+        unsigned long distance = strtoul(csv_field(table, PATH_COLUMNS_COUNT, i, PATH_DISTANCE), NULL, 10);
+        uint32_t from;
+        uint32_t to;
+        if (!parse_numeric_id(a, &from) || !parse_numeric_id(b, &to)) {
+            fprintf(stderr, "Option --stream needs numeric container IDs, line %zu of %s.\n", first_line + i + 1,
+                    path);
+            return false;
+        }
+        EdgeRecord edge = { from, to, distance < UINT32_MAX ? (uint32_t) distance : UINT32_MAX };
+        if (!add_edge(sorter, edge) || !add_edge(sorter, (EdgeRecord) { to, from, edge.distance })) {
+            fprintf(stderr, "Sorting the paths in temporary files failed.\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+// Sorts the edges of the paths file. A broken file fails silently, as when loaded whole.
+static void *spill_paths(void *argument) {
+    Stream *stream = argument;
+    EdgeSorter sorter;
+    init_edge_sorter(&sorter);
+    PathEdges edges = { stream->filters->paths_path, &sorter };
+    bool ok = parse_csv_blocks(edges.path, PATH_COLUMNS_COUNT, add_path_edges, &edges);
+    stream->paths_ok = finish_edge_sort(&sorter, &stream->neighbor_edges) && ok;
+    return NULL;
+}
+
+bool stream_containers(Writer *out, const Filters *filters) {
+    Stream stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.filters = filters;
+    stream.containers_path = filters->containers_path;
+    stream.neighbor_edges.fd = -1;
+    stream.fd = open(filters->containers_path, O_RDONLY | O_CLOEXEC);
+    if (stream.fd < 0) {
+        fprintf(stderr, "Invalid File %s.\n", filters->containers_path);
+        return false;
+    }
+    if (!init_ring(&stream.blocks, STREAM_RING_CAPACITY) || !init_ring(&stream.parsed, STREAM_RING_CAPACITY)
+        || !init_ring(&stream.selected, STREAM_RING_CAPACITY)) {
+        fail_stream(&stream, "Memory allocation failed.\n");
+    }
+
+    void *(*stages[])(void *) = { read_blocks, parse_blocks, select_batches, spill_paths };
+    pthread_t threads[4];
+    bool started[4] = { false, false, false, false };
+    bool neighbors = listing_needs_paths(filters);
+    for (size_t i = 0; !stream.failed && i < (neighbors ? 4u : 3u); i++) {
+        started[i] = pthread_create(&threads[i], NULL, stages[i], &stream) == 0;
+        if (!started[i]) {
+            fail_stream(&stream, "Memory allocation failed.\n");
+            // Ends the stages already running
+            close_ring(&stream.selected);
+            close_ring(&stream.parsed);
+            close_ring(&stream.blocks);
+        }
+    }
+
+    // Rendering, the last stage, runs on the calling thread
+    bool paths_ready = !neighbors;
+    StreamBatch *batch;
+    while (!__atomic_load_n(&stream.failed, __ATOMIC_ACQUIRE) && (batch = ring_pop(&stream.selected)) != NULL) {
+        if (!paths_ready) {
+            pthread_join(threads[3], NULL);
+            started[3] = false;
+            paths_ready = true;
+            if (!stream.paths_ok) {
+                // A broken paths file fails silently, as when loaded whole
+                __atomic_store_n(&stream.failed, true, __ATOMIC_RELEASE);
+                free_batch(batch);
+                break;
+            }
+        }
+        set_neighbor_edges(batch->data, &stream.neighbor_edges);
+
+        pin_batch_dataset(batch->data);
+        render_listing(out, filters, batch->rows, batch->rows_count);
+        pin_batch_dataset(NULL);
+        free_batch(batch);
+        // Each batch is written out as it is rendered
+        flush_writer(out);
+    }
+
+    // A failed stage stops the stages before it through their rings
+    close_ring(&stream.selected);
+    for (size_t i = 0; i < 4; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+    SpscRing *rings[] = { &stream.blocks, &stream.parsed, &stream.selected };
+    for (size_t i = 0; i < 3; i++) {
+        close_ring(rings[i]);
+        void *item;
+        while (rings[i]->slots != NULL && (item = ring_pop(rings[i])) != NULL) {
+            if (i == 0) {
+                free_block(item);
+            } else {
+                free_batch(item);
+            }
+        }
+        destroy_ring(rings[i]);
+    }
+
+    close_edge_file(&stream.neighbor_edges);
+    close(stream.fd);
+    return !stream.failed && !out->failed;
+}
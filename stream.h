@@ -0,0 +1,28 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdbool.h>
+#include "listing.h"
+#include "writer.h"
+
+/**
+ * @brief Prints the container listing of the files given by the filters
+ * while reading them, without loading the data (--stream).
+ *
+ * Reading, parsing, selecting and rendering the containers run on threads
+ * of their own, so the first rows are printed while the file is still being
+ * read. The paths are read concurrently and the rendering waits for them
+ * only if the neighbors are listed. Rows before an invalid line of the
+ * containers file may already have been printed when the listing fails.
+ *
+ * Memory use does not grow with the files: the containers are held only in
+ * the blocks in flight and the paths are sorted within the memory budget
+ * of --sort-memory, spilling to temporary files, which requires the IDs in
+ * the paths file to be numbers up to INT_MAX without leading zeros.
+ *
+ * @retval false if a file is invalid or on memory failure, with a message
+ * except for an invalid paths file.
+ */
+bool stream_containers(Writer *out, const Filters *filters);
+
+#endif // STREAM_H
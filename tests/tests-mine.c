@@ -2,11 +2,24 @@
  * You can use this file for your own tests
  */
 
+#define _DEFAULT_SOURCE
 #include "libs/cut.h"
 #include "libs/mainwrap.h"
 #include "libs/utils.h"
 
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../columnar.h"
+#include "../loader.h"
 
 /* The following “extentions” to CUT are available in this test file:
  *
@@ -30,3 +43,559 @@ TEST(my_test)
     ASSERT_FILE(stdout, correct_output);
     CHECK_FILE(stderr, "" /* STDERR is empty*/);
 }
+
+/* #desc: Nejkratší cesta mezi stanovišti */
+TEST(shortest_path)
+{
+    CHECK(app_main_args("-g", "1,5", "../tests/data/example-containers.csv", "../tests/data/example-paths.csv") == 0);
+
+    ASSERT_FILE(stdout, "1-2-3-4-5 1300\n");
+    CHECK_IS_EMPTY(stderr);
+}
+
+/* #desc: Nejkratší cesta do neexistujícího stanoviště */
+TEST(shortest_path_unknown_station)
+{
+    CHECK(app_main_args("-g", "1,9", "../tests/data/example-containers.csv", "../tests/data/example-paths.csv") != 0);
+
+    CHECK_IS_EMPTY(stdout);
+    CHECK_NOT_EMPTY(stderr);
+}
+
+/* #desc: Rozdělení stanovišť mezi depa */
+TEST(depot_partition)
+{
+    CHECK(app_main_args("-d", "1,5", "../tests/data/example-containers.csv", "../tests/data/example-paths.csv") == 0);
+
+    const char *correct_output =
+        "1->1 0\n"
+        "2->1 500\n"
+        "3->1 600\n"
+        "4->5 500\n"
+        "5->5 0\n"
+        "1;A:6100;P:5000;B:0;G:1550;C:5450;T:0\n"
+        "5;A:900;P:2000;B:3000;G:0;C:0;T:500\n"
+    ;
+
+    ASSERT_FILE(stdout, correct_output);
+    CHECK_IS_EMPTY(stderr);
+}
+
+/* #desc: Vzdálenost k nejbližšímu stanovišti s daným typem odpadu */
+TEST(type_accessibility)
+{
+    CHECK(app_main_args("-n", "../tests/data/example-containers.csv", "../tests/data/example-paths.csv") == 0);
+
+    const char *correct_output =
+        "1;0;600;800;0;0;800\n"
+        "2;100;100;300;500;0;300\n"
+        "3;0;0;200;600;0;200\n"
+        "4;200;200;0;800;200;0\n"
+        "5;0;0;500;1300;700;500\n"
+    ;
+
+    ASSERT_FILE(stdout, correct_output);
+    CHECK_IS_EMPTY(stderr);
+}
+
+/* #desc: Nejkratší cesta přes stanoviště s daným typem odpadu */
+TEST(shortest_path_via_type)
+{
+    CHECK(app_main_args("-g", "2,5", "-v", "G", "../tests/data/example-containers.csv", "../tests/data/example-paths.csv") == 0);
+
+    ASSERT_FILE(stdout, "2-1-2-3-4-5 1800\n");
+    CHECK_IS_EMPTY(stderr);
+}
+
+/* #desc: K nejkratších alternativních cest */
+TEST(k_shortest_paths)
+{
+    CHECK(app_main_args("--k-paths", "1,5,3", "../tests/data/example-containers.csv", "../tests/data/example-paths.csv") == 0);
+
+    const char *correct_output =
+        "1-2-3-4-5 1300\n"
+        "1-2-4-5 1400\n"
+    ;
+
+    ASSERT_FILE(stdout, correct_output);
+    CHECK_IS_EMPTY(stderr);
+}
+
+/* #desc: Výpis stanovišť na více vláknech zachovává pořadí */
+TEST(stations_parallel)
+{
+    CHECK(app_main_args("-j", "3", "-s", "../tests/data/example-containers.csv", "../tests/data/example-paths.csv") == 0);
+
+    const char *correct_output =
+        "1;AGC;2\n"
+        "2;C;1,3,4\n"
+        "3;APC;2,4\n"
+        "4;BT;2,3,5\n"
+        "5;AP;4\n"
+    ;
+
+    ASSERT_FILE(stdout, correct_output);
+    CHECK_IS_EMPTY(stderr);
+}
+
+/* #desc: Výběr vypisovaných polí bez načtení cest */
+TEST(listing_fields)
+{
+    CHECK(app_main_args("-f", "id,capacity", "-t", "G", "../tests/data/example-containers.csv", "nonexistent-paths.csv") == 0);
+
+    ASSERT_FILE(stdout, "ID: 2, Capacity: 1550\n");
+    CHECK_IS_EMPTY(stderr);
+}
+
+/* #desc: Výpis kontejnerů ve formátu NDJSON */
+TEST(listing_ndjson)
+{
+    CHECK(app_main_args("--format", "ndjson", "-t", "G", "../tests/data/example-containers.csv", "../tests/data/example-paths.csv") == 0);
+
+    ASSERT_FILE(stdout, "{\"id\":\"2\",\"type\":\"Clear glass\",\"capacity\":1550,\"address\":\"Drozdi 55\",\"neighbors\":[\"4\"]}\n");
+    CHECK_IS_EMPTY(stderr);
+}
+
+/* #desc: Filtr neveřejných kontejnerů v kombinaci s typem odpadu */
+TEST(public_filter_with_type)
+{
+    CHECK(app_main_args("-p", "N", "-t", "PC", "-f", "id", "../tests/data/example-containers.csv", "../tests/data/example-paths.csv") == 0);
+
+    ASSERT_FILE(stdout, "ID: 5\nID: 6\n");
+    CHECK_IS_EMPTY(stderr);
+}
+
+/* #desc: Rozsah objemu včetně hranic zachovává pořadí ze souboru */
+TEST(capacity_range_order)
+{
+    CHECK(app_main_args("-c", "900-1550", "-p", "Y", "-f", "id,capacity", "../tests/data/example-containers.csv", "../tests/data/example-paths.csv") == 0);
+
+    const char *correct_output =
+        "ID: 1, Capacity: 1550\n"
+        "ID: 2, Capacity: 1550\n"
+        "ID: 3, Capacity: 1100\n"
+        "ID: 4, Capacity: 900\n"
+        "ID: 10, Capacity: 900\n"
+    ;
+
+    ASSERT_FILE(stdout, correct_output);
+    CHECK_IS_EMPTY(stderr);
+}
+
+/* #desc: Filtrovací výraz s typy, objemem a ulicí */
+TEST(query_expression)
+{
+    CHECK(app_main_args("-q", "type in (C,P) and not capacity < 3000 or street ~ \"Dro\" and type = G", "-f", "id",
+                        "../tests/data/example-containers.csv", "../tests/data/example-paths.csv") == 0);
+
+    ASSERT_FILE(stdout, "ID: 2\nID: 5\nID: 6\n");
+    CHECK_IS_EMPTY(stderr);
+}
+
+/* #desc: Chybný filtrovací výraz */
+TEST(query_syntax_error)
+{
+    CHECK(app_main_args("-q", "capacity >", "../tests/data/example-containers.csv", "../tests/data/example-paths.csv") != 0);
+
+    CHECK_IS_EMPTY(stdout);
+    CHECK_NOT_EMPTY(stderr);
+}
+
+/* #desc: Dávka výpisů nad jedním načtením dat */
+TEST(batch_listings)
+{
+    CHECK(app_main_args("-j", "2", "-b", "../tests/data/example-batch.txt", "../tests/data/example-containers.csv",
+                        "../tests/data/example-paths.csv") == 0);
+
+    const char *correct_output =
+        "=== -t C -f id\n"
+        "ID: 1\n"
+        "ID: 4\n"
+        "ID: 6\n"
+        "=== -p Y -c 2000-5000 -f id,capacity\n"
+        "ID: 8, Capacity: 3000\n"
+        "ID: 11, Capacity: 2000\n"
+    ;
+
+    ASSERT_FILE(stdout, correct_output);
+    CHECK_IS_EMPTY(stderr);
+}
+
+/* #desc: Součty objemů podle typu odpadu */
+TEST(aggregate_by_type)
+{
+    CHECK(app_main_args("-a", "type", "-p", "Y", "../tests/data/example-containers.csv",
+                        "../tests/data/example-paths.csv") == 0);
+
+    ASSERT_FILE(stdout, "A;2;2000\nP;1;2000\nB;1;3000\nG;1;1550\nC;2;2450\nT;1;500\n");
+    CHECK_IS_EMPTY(stderr);
+}
+
+/* #desc: Stanoviště s největším celkovým objemem */
+TEST(top_stations)
+{
+    CHECK(app_main_args("--top", "3", "--by", "capacity", "../tests/data/example-containers.csv",
+                        "../tests/data/example-paths.csv") == 0);
+
+    ASSERT_FILE(stdout, "3;13000\n1;4200\n4;3500\n");
+    CHECK_IS_EMPTY(stderr);
+}
+
+#define TEST_SOCKET "container-explorer-test.sock"
+
+/* Starts the server with the given threads and containers file in a child
+ * process; stop it by stop_server(). */
+static pid_t start_server(const char *threads, const char *containers_path)
+{
+    remove(TEST_SOCKET);
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(app_main_args("--serve", TEST_SOCKET, "-j", threads, containers_path, "../tests/data/example-paths.csv"));
+    }
+    return pid;
+}
+
+/* Sends the request to the server started by start_server(), trying to
+ * connect for a second and a half, and reads the body of the response. Returns
+ * the status of the response, -1 if the request fails. */
+static int request_server(const char *request, char *body, size_t body_size)
+{
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    strcpy(address.sun_path, TEST_SOCKET);
+    int fd = -1;
+    for (int attempt = 0; attempt < 150 && fd < 0; attempt++) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+            close(fd);
+            fd = -1;
+            usleep(10000);
+        }
+    }
+    if (fd < 0) {
+        return -1;
+    }
+
+    uint32_t length = (uint32_t) strlen(request);
+    unsigned char frame[4] = { length >> 24, length >> 16, length >> 8, length };
+    unsigned char header[5];
+    int status = -1;
+    if (write(fd, frame, 4) == 4 && write(fd, request, length) == (ssize_t) length
+        && recv(fd, header, 5, MSG_WAITALL) == 5) {
+        size_t body_length = (size_t) header[0] << 24 | (size_t) header[1] << 16 | (size_t) header[2] << 8 | header[3];
+        if (body_length < body_size && recv(fd, body, body_length, MSG_WAITALL) == (ssize_t) body_length) {
+            body[body_length] = '\0';
+            status = header[4];
+        }
+    }
+    close(fd);
+    return status;
+}
+
+/* Stops the server by SIGTERM; returns its exit status, -1 if it did not
+ * exit by itself or left the socket behind. */
+static int stop_server(pid_t pid)
+{
+    int status;
+    if (kill(pid, SIGTERM) != 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+        return -1;
+    }
+    return access(TEST_SOCKET, F_OK) == 0 ? -1 : WEXITSTATUS(status);
+}
+
+/* #desc: Server přijímá filtry výpisu jen v jednotlivých dotazech */
+TEST(serve_rejects_listing_filters)
+{
+    CHECK(app_main_args("--serve", "container-explorer.sock", "-t", "A", "../tests/data/example-containers.csv",
+                        "../tests/data/example-paths.csv") != 0);
+
+    CHECK_IS_EMPTY(stdout);
+    CHECK_NOT_EMPTY(stderr);
+}
+
+/* #desc: Výpis ze sdíleného snímku dat */
+TEST(publish_and_attach_snapshot)
+{
+    CHECK(app_main_args("--publish", "container-explorer-test.snapshot", "../tests/data/example-containers.csv",
+                        "../tests/data/example-paths.csv") == 0);
+    CHECK(app_main_args("--attach", "container-explorer-test.snapshot", "--top", "3") == 0);
+    remove("container-explorer-test.snapshot");
+
+    ASSERT_FILE(stdout, "3;13000\n1;4200\n4;3500\n");
+    CHECK_IS_EMPTY(stderr);
+}
+
+/* #desc: Cesta k neexistujícímu kontejneru */
+TEST(path_to_unknown_container)
+{
+    CHECK(app_main_args("../tests/data/example-containers.csv", "../tests/data/example-paths-unknown.csv") != 0);
+
+    CHECK_IS_EMPTY(stdout);
+    ASSERT_FILE(stderr, "Unknown container 42 on line 2 of ../tests/data/example-paths-unknown.csv.\n");
+}
+
+/* #desc: Průběžný výpis během čtení souborů */
+TEST(stream_listing)
+{
+    CHECK(app_main_args("--stream", "-c", "1000-2000", "-f", "id,capacity,neighbors",
+                        "../tests/data/example-containers.csv", "../tests/data/example-paths.csv") == 0);
+
+    ASSERT_FILE(stdout, "ID: 1, Capacity: 1550, Neighbors: 4\n"
+                        "ID: 2, Capacity: 1550, Neighbors: 4\n"
+                        "ID: 3, Capacity: 1100, Neighbors: 4\n"
+                        "ID: 11, Capacity: 2000, Neighbors: 8\n");
+    CHECK_IS_EMPTY(stderr);
+}
+
+/* #desc: Dostupnost typů odpadu s vyhledáváním na sdílených vláknech */
+TEST(type_accessibility_parallel)
+{
+    CHECK(app_main_args("-j", "4", "-n", "../tests/data/example-containers.csv", "../tests/data/example-paths.csv") == 0);
+
+    const char *correct_output =
+        "1;0;600;800;0;0;800\n"
+        "2;100;100;300;500;0;300\n"
+        "3;0;0;200;600;0;200\n"
+        "4;200;200;0;800;200;0\n"
+        "5;0;0;500;1300;700;500\n"
+    ;
+
+    ASSERT_FILE(stdout, correct_output);
+    CHECK_IS_EMPTY(stderr);
+}
+
+/* #desc: Průběžný výpis vyžaduje číselná ID v souboru cest */
+TEST(stream_listing_text_ids)
+{
+    CHECK(app_main_args("--stream", "../tests/data/example-containers.csv", "../tests/data/example-paths-text.csv") != 0);
+
+    CHECK_IS_EMPTY(stdout);
+    ASSERT_FILE(stderr, "Option --stream needs numeric container IDs, line 2 of ../tests/data/example-paths-text.csv.\n");
+}
+
+/* #desc: Stanice s omezenou pamětí pro řazení cest, slučovanou na více průchodů */
+TEST(stations_with_sort_memory)
+{
+    CHECK(app_main_args("--sort-memory", "96B", "--temp-dir", ".", "-s", "../tests/data/example-containers.csv",
+                        "../tests/data/example-paths.csv") == 0);
+
+    const char *correct_output =
+        "1;AGC;2\n"
+        "2;C;1,3,4\n"
+        "3;APC;2,4\n"
+        "4;BT;2,3,5\n"
+        "5;AP;4\n"
+    ;
+
+    ASSERT_FILE(stdout, correct_output);
+    CHECK_IS_EMPTY(stderr);
+}
+
+/* #desc: Průběžný výpis sousedů z cest seřazených na disku po malých blocích */
+TEST(stream_listing_with_sort_memory)
+{
+    CHECK(app_main_args("--stream", "--sort-memory", "96B", "--temp-dir", ".", "-f", "id,neighbors",
+                        "../tests/data/example-containers.csv", "../tests/data/example-paths.csv") == 0);
+
+    const char *correct_output =
+        "ID: 1, Neighbors: 4\n"
+        "ID: 2, Neighbors: 4\n"
+        "ID: 3, Neighbors: 4\n"
+        "ID: 4, Neighbors: 1 2 3 5 8\n"
+        "ID: 5, Neighbors: 4 8\n"
+        "ID: 6, Neighbors: 8\n"
+        "ID: 7, Neighbors: 8\n"
+        "ID: 8, Neighbors: 4 5 6 7 11\n"
+        "ID: 9, Neighbors: 10\n"
+        "ID: 10, Neighbors: 9\n"
+        "ID: 11, Neighbors: 8\n"
+    ;
+
+    ASSERT_FILE(stdout, correct_output);
+    CHECK_IS_EMPTY(stderr);
+}
+
+/* #desc: Server s více vlákny přežije opakované načtení dat */
+TEST(serve_reload_with_threads)
+{
+    char body[256];
+    pid_t server = start_server("4", "../tests/data/example-containers.csv");
+    CHECK(request_server("-t A -f id", body, sizeof(body)) == 0);
+
+    // Signals may reach any thread of the server, its loop takes them
+    for (int i = 0; i < 5; i++) {
+        kill(server, SIGHUP);
+        usleep(50000);
+    }
+    CHECK(request_server("-t A -f id", body, sizeof(body)) == 0);
+    CHECK(strcmp(body, "ID: 3\nID: 7\nID: 10\n") == 0);
+    CHECK(stop_server(server) == 0);
+}
+
+/* #desc: Server odmítne dotaz s neplatným rozsahem objemu */
+TEST(serve_rejects_invalid_capacity)
+{
+    char body[256];
+    pid_t server = start_server("1", "../tests/data/example-containers.csv");
+    CHECK(request_server("-c abc -f id", body, sizeof(body)) == 1);
+    CHECK(strstr(body, "Invalid value for -c.") != NULL);
+    CHECK(request_server("-c 1000", body, sizeof(body)) == 1);
+    CHECK(request_server("-c 1000-2000x", body, sizeof(body)) == 1);
+    CHECK(request_server("-c 1000-1100 -f id", body, sizeof(body)) == 0);
+    CHECK(strcmp(body, "ID: 3\n") == 0);
+    CHECK(stop_server(server) == 0);
+}
+
+/* Copies the example containers to the path, with container 5 of the type
+ * Plastics and Aluminium if changed. Returns 0 if the copy fails. */
+static int write_containers(const char *path, int changed)
+{
+    FILE *source = fopen("../tests/data/example-containers.csv", "r");
+    FILE *target = fopen(path, "w");
+    int ok = source != NULL && target != NULL;
+    char line[256];
+    while (ok && fgets(line, sizeof(line), source) != NULL) {
+        char *paper = changed && strncmp(line, "5,", 2) == 0 ? strstr(line, ",Paper,") : NULL;
+        if (paper != NULL) {
+            ok = fprintf(target, "%.*s,Plastics and Aluminium,%s", (int) (paper - line), line, paper + 7) > 0;
+        } else {
+            ok = fputs(line, target) >= 0;
+        }
+    }
+    if (source != NULL) {
+        fclose(source);
+    }
+    return target != NULL && fclose(target) == 0 && ok;
+}
+
+/* #desc: Server odpovídá na výpis i trasu a po SIGHUP odpovídá z nových dat */
+TEST(serve_answers_from_reloaded_data)
+{
+    const char *containers = "container-explorer-test-containers.csv";
+    char body[256];
+    CHECK(write_containers(containers, 0));
+    pid_t server = start_server("2", containers);
+
+    CHECK(request_server("-t A -f id", body, sizeof(body)) == 0);
+    CHECK(strcmp(body, "ID: 3\nID: 7\nID: 10\n") == 0);
+    CHECK(request_server("-g 1,3", body, sizeof(body)) == 0);
+    CHECK(strcmp(body, "1-2-3 600\n") == 0);
+
+    CHECK(write_containers(containers, 1));
+    kill(server, SIGHUP);
+    // The reload finishes in the background, the old version answers until then
+    for (int attempt = 0; attempt < 100; attempt++) {
+        CHECK(request_server("-t A -f id", body, sizeof(body)) == 0);
+        if (strcmp(body, "ID: 3\nID: 7\nID: 10\n") != 0) {
+            break;
+        }
+        usleep(10000);
+    }
+    CHECK(strcmp(body, "ID: 3\nID: 5\nID: 7\nID: 10\n") == 0);
+    CHECK(request_server("-g 1,3", body, sizeof(body)) == 0);
+    CHECK(strcmp(body, "1-2-3 600\n") == 0);
+
+    CHECK(stop_server(server) == 0);
+    remove(containers);
+}
+
+/* #desc: Příliš mnoho vláken */
+TEST(too_many_threads)
+{
+    CHECK(app_main_args("-j", "100000", "../tests/data/example-containers.csv",
+                        "../tests/data/example-paths.csv") != 0);
+
+    CHECK_IS_EMPTY(stdout);
+    ASSERT_FILE(stderr, "Invalid value for -j. Use a positive count of threads up to 256.\n");
+}
+
+/* #desc: Dávka ve sloupcovém formátu začíná hlavičkou a popisy sloupců */
+TEST(batch_columnar_header)
+{
+    const char *output = "container-explorer-test-cols";
+    mkdir(output, 0755);
+    CHECK(app_main_args("--format", "columnar", "-b", "../tests/data/example-batch.txt", "-o", output,
+                        "../tests/data/example-containers.csv", "../tests/data/example-paths.csv") == 0);
+    CHECK_IS_EMPTY(stdout);
+    CHECK_IS_EMPTY(stderr);
+
+    // -p Y -c 2000-5000 -f id,capacity gives the containers 8 and 11
+    FILE *file = fopen("container-explorer-test-cols/query-2.cols", "rb");
+    ColumnarHeader header;
+    ColumnDescriptor descriptors[2];
+    uint64_t capacities[2];
+    CHECK(file != NULL);
+    CHECK(fread(&header, sizeof(header), 1, file) == 1);
+    CHECK(memcmp(header.magic, COLUMNAR_MAGIC, sizeof(header.magic)) == 0);
+    CHECK(header.rows == 2);
+    CHECK(header.columns_count == 2);
+    CHECK(fread(descriptors, sizeof(ColumnDescriptor), 2, file) == 2);
+    CHECK(strcmp(descriptors[0].name, "id") == 0);
+    CHECK(descriptors[0].kind == COLUMN_STRING);
+    CHECK(descriptors[0].values == sizeof(header) + sizeof(descriptors));
+    CHECK(strcmp(descriptors[1].name, "capacity") == 0);
+    CHECK(descriptors[1].kind == COLUMN_U64);
+    CHECK(descriptors[1].values % 8 == 0);
+    CHECK(fseek(file, (long) descriptors[1].values, SEEK_SET) == 0);
+    CHECK(fread(capacities, sizeof(uint64_t), 2, file) == 2);
+    CHECK(capacities[0] == 3000 && capacities[1] == 2000);
+    fclose(file);
+
+    remove("container-explorer-test-cols/query-1.cols");
+    remove("container-explorer-test-cols/query-2.cols");
+    rmdir(output);
+}
+
+/* Byte of the test file at the offset, different in every chunk. */
+static char loader_test_byte(size_t offset)
+{
+    return (char) ('a' + (offset + offset / LOADER_CHUNK_SIZE) % 26);
+}
+
+/* #desc: Čtení souborů vlákny po více blocích až do konce souboru */
+TEST(loader_threads_chunks)
+{
+    // Two and a half chunks, so the last one ends before a chunk does
+    const size_t size = 2 * LOADER_CHUNK_SIZE + LOADER_CHUNK_SIZE / 2 + 3;
+    const char *paths[] = { "container-explorer-test-large.bin", "../tests/data/example-paths.csv",
+                            "container-explorer-test-missing.bin" };
+    FILE *file = fopen(paths[0], "wb");
+    CHECK(file != NULL);
+    for (size_t offset = 0; offset < size; offset++) {
+        fputc(loader_test_byte(offset), file);
+    }
+    fclose(file);
+
+    loader_threads_only = 1;
+    Loader *loader = start_loading(paths, 3);
+    CHECK(loader != NULL);
+    LoadedFile *large = loaded_file(loader, 0);
+    LoadedFile *small = loaded_file(loader, 1);
+    CHECK(large->size == size);
+
+    // Chunks arrive in the order of the file, whatever order the threads read them in
+    size_t arrived = 0;
+    size_t waits = 0;
+    size_t wrong = 0;
+    while (wait_for_loading(loader)) {
+        CHECK(large->arrived >= arrived && large->arrived <= size);
+        for (size_t offset = arrived; offset < large->arrived; offset++) {
+            wrong += large->data[offset] != loader_test_byte(offset);
+        }
+        arrived = large->arrived;
+        waits++;
+    }
+    CHECK(waits > 0);
+    CHECK(wrong == 0);
+    CHECK(!large->failed && large->arrived == size && large->data[size] == '\0');
+    CHECK(!small->failed && small->arrived == small->size && small->data[small->size] == '\0');
+    CHECK(strncmp(small->data, "1,4,500\n", 8) == 0);
+    CHECK(loaded_file(loader, 2)->failed);
+    CHECK(!wait_for_loading(loader));
+
+    // The data outlives the loader, the states of the files do not
+    char *data[] = { large->data, small->data };
+    finish_loading(loader);
+    free(data[0]);
+    free(data[1]);
+    remove(paths[0]);
+}
@@ -0,0 +1,217 @@
+#define _DEFAULT_SOURCE
+#include "writer.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "scheduler.h"
+
+// Chunks per thread, so that threads finishing early steal the rest.
+#define RENDER_CHUNKS_PER_THREAD 4
+
+// Output at least this long bypasses the buffer when it does not fit.
+#define WRITER_DIRECT_SIZE (WRITER_BUFFER_SIZE / 2)
+
+static const char digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+bool init_writer(Writer *writer, int fd) {
+    writer->fd = fd;
+    writer->length = 0;
+    writer->capacity = WRITER_BUFFER_SIZE;
+    writer->failed = false;
+    writer->data = malloc(WRITER_BUFFER_SIZE);
+    return writer->data != NULL;
+}
+
+void destroy_writer(Writer *writer) {
+    free(writer->data);
+    writer->data = NULL;
+    writer->length = writer->capacity = 0;
+}
+
+// Writes all the vectors, resuming after partial writes and interrupts.
+static bool write_vectors(int fd, struct iovec *vectors, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, vectors, count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        size_t remaining = (size_t) written;
+        while (count > 0 && remaining >= vectors->iov_len) {
+            remaining -= vectors->iov_len;
+            vectors++;
+            count--;
+        }
+        if (count > 0) {
+            vectors->iov_base = (char *) vectors->iov_base + remaining;
+            vectors->iov_len -= remaining;
+        }
+    }
+    return true;
+}
+
+// Passes the buffer and optionally one more block to the descriptor at once.
+static void drain(Writer *writer, const char *bytes, size_t length) {
+    if (writer->fd == STDOUT_FILENO) {
+        fflush(stdout);
+    }
+
+    struct iovec vectors[2] = {
+        { writer->data, writer->length },
+        { (void *) bytes, length },
+    };
+    if (!write_vectors(writer->fd, vectors, length > 0 ? 2 : 1)) {
+        writer->failed = true;
+    }
+    writer->length = 0;
+}
+
+void write_bytes_slow(Writer *writer, const char *bytes, size_t length) {
+    if (writer->failed || writer->data == NULL) {
+        writer->failed = true;
+        return;
+    }
+
+    if (writer->fd >= 0) {
+        if (length >= WRITER_DIRECT_SIZE) {
+            drain(writer, bytes, length);
+            return;
+        }
+        drain(writer, NULL, 0);
+    } else {
+        size_t capacity = writer->capacity;
+        while (capacity - writer->length < length) {
+            capacity *= 2;
+        }
+        char *data = realloc(writer->data, capacity);
+        if (data == NULL) {
+            writer->failed = true;
+            return;
+        }
+        writer->data = data;
+        writer->capacity = capacity;
+    }
+
+    memcpy(writer->data + writer->length, bytes, length);
+    writer->length += length;
+}
+
+bool flush_writer(Writer *writer) {
+    if (writer->fd >= 0 && writer->length > 0 && !writer->failed) {
+        drain(writer, NULL, 0);
+    }
+    return !writer->failed;
+}
+
+// Digits are produced two at a time from the end of a local buffer.
+void write_uint(Writer *writer, unsigned long long value) {
+    char digits[20];
+    char *end = digits + sizeof(digits);
+    char *start = end;
+
+    while (value >= 100) {
+        unsigned pair = (unsigned) (value % 100) * 2;
+        value /= 100;
+        start -= 2;
+        start[0] = digit_pairs[pair];
+        start[1] = digit_pairs[pair + 1];
+    }
+    if (value >= 10) {
+        start -= 2;
+        start[0] = digit_pairs[value * 2];
+        start[1] = digit_pairs[value * 2 + 1];
+    } else {
+        *--start = (char) ('0' + value);
+    }
+
+    write_bytes(writer, start, (size_t) (end - start));
+}
+
+void write_json_chars(Writer *writer, const char *string) {
+    static const char hex_digits[] = "0123456789abcdef";
+    const char *run = string;
+    for (const char *c = string; *c != '\0'; c++) {
+        unsigned char byte = (unsigned char) *c;
+        if (byte >= 0x20 && byte != '"' && byte != '\\') {
+            continue;
+        }
+
+        write_bytes(writer, run, (size_t) (c - run));
+        run = c + 1;
+        if (byte == '"' || byte == '\\') {
+            write_char(writer, '\\');
+            write_char(writer, (char) byte);
+        } else {
+            char escape[] = { '\\', 'u', '0', '0', hex_digits[byte >> 4], hex_digits[byte & 0xf] };
+            write_bytes(writer, escape, sizeof(escape));
+        }
+    }
+    write_bytes(writer, run, strlen(run));
+}
+
+typedef struct {
+    RenderRange render;
+    const void *context;
+    size_t rows;
+    size_t chunks_count;
+    Writer *chunks;
+} RenderJob;
+
+static void render_chunks(size_t begin, size_t end, void *argument) {
+    RenderJob *job = argument;
+    for (size_t chunk = begin; chunk < end; chunk++) {
+        size_t first = job->rows * chunk / job->chunks_count;
+        size_t last = job->rows * (chunk + 1) / job->chunks_count;
+        job->render(&job->chunks[chunk], first, last, job->context);
+    }
+}
+
+bool render_parallel(Writer *out, size_t rows, unsigned threads, RenderRange render, const void *context) {
+    if (threads > scheduler_threads()) {
+        threads = scheduler_threads();
+    }
+    if (threads <= 1 || rows < 2) {
+        render(out, 0, rows, context);
+        return !out->failed;
+    }
+
+    RenderJob job = { render, context, rows, (size_t) threads * RENDER_CHUNKS_PER_THREAD, NULL };
+    if (job.chunks_count > rows) {
+        job.chunks_count = rows;
+    }
+    job.chunks = calloc(job.chunks_count, sizeof(Writer));
+    bool ok = job.chunks != NULL;
+    for (size_t i = 0; ok && i < job.chunks_count; i++) {
+        ok = init_writer(&job.chunks[i], -1);
+    }
+
+    if (ok) {
+        parallel_for(job.chunks_count, 1, render_chunks, &job);
+        for (size_t i = 0; i < job.chunks_count; i++) {
+            ok &= !job.chunks[i].failed;
+            write_bytes(out, job.chunks[i].data, job.chunks[i].length);
+        }
+    }
+
+    for (size_t i = 0; job.chunks != NULL && i < job.chunks_count; i++) {
+        destroy_writer(&job.chunks[i]);
+    }
+    free(job.chunks);
+    return ok && !out->failed;
+}
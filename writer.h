@@ -0,0 +1,122 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+// Size of the user-space buffer of a writer.
+#define WRITER_BUFFER_SIZE (64 * 1024)
+
+/**
+ * @brief Buffered output to a file descriptor or to memory.
+ *
+ * Output is collected in a large buffer and passed to the descriptor with
+ * write() or writev() once full, bypassing stdio locking and format parsing.
+ * A writer without a descriptor (fd < 0) keeps all output in the buffer,
+ * which grows as needed.
+ *
+ * Errors are sticky: after a failed allocation or write, further output is
+ * dropped and flush_writer() reports the failure.
+ */
+typedef struct {
+    int fd;
+    char *data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+} Writer;
+
+/**
+ * @brief Prepares a writer.
+ *
+ * @param fd descriptor to write to, or -1 to collect the output in memory.
+ * @retval false on memory failure.
+ */
+bool init_writer(Writer *writer, int fd);
+
+// Frees the buffer of the writer without flushing it.
+void destroy_writer(Writer *writer);
+
+/**
+ * @brief Passes the buffered output to the descriptor.
+ *
+ * Pending stdio output of the same descriptor is flushed first, so output
+ * printed before keeps its order. Writers kept in memory are not affected.
+ *
+ * @retval false if any output was lost since the writer was initialized.
+ */
+bool flush_writer(Writer *writer);
+
+// Slow path of write_bytes() for output not fitting the buffer.
+void write_bytes_slow(Writer *writer, const char *bytes, size_t length);
+
+// Appends length bytes.
+static inline void write_bytes(Writer *writer, const char *bytes, size_t length) {
+    if (writer->capacity - writer->length >= length) {
+        memcpy(writer->data + writer->length, bytes, length);
+        writer->length += length;
+    } else {
+        write_bytes_slow(writer, bytes, length);
+    }
+}
+
+// Appends a string literal without measuring it at run time.
+#define write_literal(writer, literal) write_bytes((writer), "" literal, sizeof(literal) - 1)
+
+// Appends a null-terminated string.
+static inline void write_string(Writer *writer, const char *string) {
+    write_bytes(writer, string, strlen(string));
+}
+
+// Appends one character.
+static inline void write_char(Writer *writer, char c) {
+    if (writer->length < writer->capacity) {
+        writer->data[writer->length++] = c;
+    } else {
+        write_bytes_slow(writer, &c, 1);
+    }
+}
+
+// Appends the decimal representation of the value.
+void write_uint(Writer *writer, unsigned long long value);
+
+// Appends the decimal representation of the value, with a minus sign if negative.
+static inline void write_int(Writer *writer, long long value) {
+    if (value < 0) {
+        write_char(writer, '-');
+        write_uint(writer, 0ull - (unsigned long long) value);
+    } else {
+        write_uint(writer, (unsigned long long) value);
+    }
+}
+
+// Appends the string escaped for the inside of a JSON string: quotes, backslashes and control characters.
+void write_json_chars(Writer *writer, const char *string);
+
+// Appends the string as a quoted JSON string.
+static inline void write_json_string(Writer *writer, const char *string) {
+    write_char(writer, '"');
+    write_json_chars(writer, string);
+    write_char(writer, '"');
+}
+
+// Renders the rows from begin up to end - 1 into out.
+typedef void (*RenderRange)(Writer *out, size_t begin, size_t end, const void *context);
+
+/**
+ * @brief Renders rows on several threads with the output of the sequential run.
+ *
+ * The rows are split into contiguous chunks, each rendered into a private
+ * memory writer by a thread of the scheduler. The chunks are then appended
+ * to out in the order of their rows.
+ *
+ * @param rows count of rows to render.
+ * @param threads count of threads, at most those of the scheduler; 1
+ * renders directly into out.
+ * @param context passed to render unchanged; must be safe to share.
+ * @retval false on memory failure.
+ */
+bool render_parallel(Writer *out, size_t rows, unsigned threads, RenderRange render, const void *context);
+
+#endif // WRITER_H